@@ -12,10 +12,73 @@
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <time.h>
+#include <errno.h>
 
 #define WIN_W 1280
 #define WIN_H 768
 
+/* ---------------- allocation tracking (build with -DJUMPI_TRACK_ALLOCS) ---------------- */
+/* Counts every malloc/calloc/realloc/free made by the game and, through
+ * SDL_SetMemoryFunctions, by SDL and SDL_ttf, bucketed per frame by the subsystem
+ * that was running. Gameplay frames after warm-up must not allocate; any that do are
+ * reported and make the process exit non-zero, so `--frames N` runs can gate on it.
+ * Only the main thread's allocations are counted per frame: worker threads (preloads,
+ * generation, saves) allocate off the frame and only add to the atomic totals. */
+enum { ALLOC_SYS_OTHER,
+	   ALLOC_SYS_EVENTS,
+	   ALLOC_SYS_PHYSICS,
+	   ALLOC_SYS_WORLD,
+	   ALLOC_SYS_UI,
+	   ALLOC_SYS_PRESENT,
+	   ALLOC_SYS_COUNT };
+#ifdef JUMPI_TRACK_ALLOCS
+static const char *alloc_sys_names[ALLOC_SYS_COUNT] = {"other", "events", "physics", "world", "ui", "present"};
+static int alloc_sys = ALLOC_SYS_OTHER;
+static long alloc_frame[ALLOC_SYS_COUNT], free_frame[ALLOC_SYS_COUNT]; /* main thread only */
+static SDL_atomic_t alloc_total, free_total;
+static SDL_threadID alloc_main_thread = 0;
+static long steady_alloc_frames = 0;
+
+static void track_count(long *frame) {
+	if (SDL_ThreadID() == alloc_main_thread) ++frame[alloc_sys];
+}
+static void *track_malloc(size_t n) {
+	track_count(alloc_frame);
+	SDL_AtomicAdd(&alloc_total, 1);
+	return (malloc)(n);
+}
+static void *track_calloc(size_t c, size_t n) {
+	track_count(alloc_frame);
+	SDL_AtomicAdd(&alloc_total, 1);
+	return (calloc)(c, n);
+}
+static void *track_realloc(void *p, size_t n) {
+	track_count(alloc_frame);
+	SDL_AtomicAdd(&alloc_total, 1);
+	return (realloc)(p, n);
+}
+static void track_free(void *p) {
+	if (!p) return;
+	track_count(free_frame);
+	SDL_AtomicAdd(&free_total, 1);
+	(free)(p);
+}
+#define malloc(n) track_malloc(n)
+#define calloc(c, n) track_calloc(c, n)
+#define realloc(p, n) track_realloc(p, n)
+#define free(p) track_free(p)
+#define ALLOC_SCOPE(s) (alloc_sys = (s))
+static int alloc_expected = 0; /* this frame allocates on purpose (level switch, save) */
+#define ALLOC_EXPECTED() (alloc_expected = 1)
+#else
+#define ALLOC_SCOPE(s) ((void) 0)
+#define ALLOC_EXPECTED() ((void) 0)
+#endif
+
 #define MAP_DEFAULT_SIZE 64
 #define CELL_SIZE 1.0
 #define PLAYER_RADIUS 0.28
@@ -54,11 +117,36 @@ typedef struct {
 	int mouse_dy;
 } Input;
 
-/* map */
+/* arena: one block, bump allocation, freed all at once */
+typedef struct {
+	uint8_t *base;
+	size_t used, cap;
+} Arena;
+
+/* a map owns both grids through a single arena */
+typedef struct {
+	int w, h;
+	uint8_t *cells;
+	uint8_t *rots;
+	Arena mem;
+	/* what the JSON loader had to fix up: rotations wrapped into 0-3, rows that were
+	 * short, long or missing against width/height */
+	uint32_t wrapped_rots, ragged_rows;
+} Map;
+
+/* map (globals alias the grids of cur_map) */
+static Map cur_map;
+static size_t map_side_bytes = 0; /* grids held besides cur_map (a preloaded level, a save snapshot), counted under MEM_MAP */
 static int map_w = MAP_DEFAULT_SIZE;
 static int map_h = MAP_DEFAULT_SIZE;
 static uint8_t *map_cells = NULL;
 static uint8_t *map_rots = NULL;
+static char map_path[512] = {0}; /* file the current map came from, "" if generated */
+static unsigned map_edit_serial = 0; /* bumped by every grid write */
+static unsigned map_saved_serial = 0, map_autosaved_serial = 0;
+static double autosave_last = 0.0; /* the autosave interval counts from here */
+static int sel_state = 0; /* editor selection: 0 none, 1 first corner set, 2 rectangle */
+static int sel_x0, sel_z0, sel_x1, sel_z1;
 
 /* UI */
 static int menu_open = 0;
@@ -68,6 +156,14 @@ static char load_path[512] = {0};
 static int load_path_len = 0;
 static char load_err[256] = {0};
 
+/* run timing / results */
+static double run_time = 0.0;
+static int run_recorded = 0;
+static uint32_t result_ms = 0;
+static int result_rank = 0, result_total = 0;
+static uint32_t result_best[3];
+static int result_nbest = 0;
+
 /* settings */
 static double mouse_sensitivity = 0.0028;
 static int invert_mouse_y = 1;
@@ -88,6 +184,18 @@ static double BUNNY_HOP_TIME = 0.1;// Allow jumping for 0.1s after leaving groun
 /* font */
 static TTF_Font *gfont = NULL;
 
+/* memory accounting: bytes held per subsystem, with optional budgets (0 = none) */
+enum { MEM_MAP,
+	   MEM_RENDER,
+	   MEM_TEXT,
+	   MEM_UNDO,
+	   MEM_SCORES,
+	   MEM_SYS_COUNT };
+static const char *mem_sys_names[MEM_SYS_COUNT] = {"map", "render", "text", "undo", "scores"};
+static size_t mem_used[MEM_SYS_COUNT];
+static size_t mem_budget[MEM_SYS_COUNT] = {0, 0, 2u << 20, 8u << 20, 0};
+static int mem_over(int sys, size_t extra) { return mem_budget[sys] && mem_used[sys] + extra > mem_budget[sys]; }
+
 /* helpers */
 static double clampd(double v, double a, double b) { return v < a ? a : (v > b ? b : v); }
 static double lerp(double a, double b, double t) { return a + (b - a) * t; }
@@ -98,24 +206,387 @@ static double approach(double cur, double target, double maxDelta) {
 	return target;
 }
 static double now_seconds(void) { return SDL_GetPerformanceCounter() / (double) SDL_GetPerformanceFrequency(); }
+/* per-user data directory (~/.local/share/jumpi), falling back to the working directory */
+static const char *data_path(const char *name, char *out, size_t n) {
+	const char *home = getenv("HOME");
+	if (home && *home) {
+		char dir[512];
+		snprintf(dir, sizeof(dir), "%s/.local", home);
+		mkdir(dir, 0755);
+		snprintf(dir, sizeof(dir), "%s/.local/share", home);
+		mkdir(dir, 0755);
+		snprintf(dir, sizeof(dir), "%s/.local/share/jumpi", home);
+		mkdir(dir, 0755);
+		snprintf(out, n, "%s/%s", dir, name);
+	} else
+		snprintf(out, n, "%s", name);
+	return out;
+}
+
+/* ---------------- arena allocator ---------------- */
+#define ARENA_ALIGN 16
+
+static int arena_init(Arena *a, size_t cap) {
+	a->base = (uint8_t *) malloc(cap ? cap : 1);
+	a->used = 0;
+	a->cap = a->base ? cap : 0;
+	return a->base ? 0 : -2;
+}
+
+static void *arena_alloc(Arena *a, size_t n) {
+	size_t off = (a->used + (ARENA_ALIGN - 1)) & ~(size_t) (ARENA_ALIGN - 1);
+	if (off > a->cap || n > a->cap - off) return NULL;
+	a->used = off + n;
+	return a->base + off;
+}
+
+static void arena_free(Arena *a) {
+	free(a->base);
+	a->base = NULL;
+	a->used = a->cap = 0;
+}
+
+/* ---------------- chunked render cache ---------------- */
+/* The map is split into CHUNK_SIZE x CHUNK_SIZE chunks, each caching the local indices
+ * of its non-empty tiles. draw_map walks only those and skips whole chunks behind the
+ * camera. An edit marks just its chunk dirty and the chunk is rebuilt on the next draw,
+ * so edits cost one chunk regardless of map size. Collision reads the grid directly and
+ * needs no invalidation. */
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+
+typedef struct {
+	uint16_t count;
+	uint8_t dirty;
+	uint32_t gen; /* unique per rebuild, so other caches can tell the contents changed */
+	uint8_t idx[CHUNK_SIZE * CHUNK_SIZE]; /* local z * CHUNK_SIZE + x */
+} Chunk;
+
+static Chunk *chunks = NULL;
+static int chunks_w = 0, chunks_h = 0;
+static uint32_t chunk_gen = 0;
+
+/* size the cache for the current map and mark everything dirty */
+static void chunk_cache_reset(void) {
+	int cw = (map_w + CHUNK_SIZE - 1) >> CHUNK_SHIFT, ch = (map_h + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+	if (cw * ch != chunks_w * chunks_h) {
+		free(chunks);
+		chunks = (Chunk *) malloc((size_t) cw * ch * sizeof(Chunk));
+		if (!chunks) cw = ch = 0;
+	}
+	chunks_w = cw;
+	chunks_h = ch;
+	for (int i = 0; i < cw * ch; ++i) {
+		chunks[i].count = 0;
+		chunks[i].dirty = 1;
+	}
+	mem_used[MEM_RENDER] = (size_t) cw * ch * sizeof(Chunk);
+}
+
+static void chunk_cache_free(void) {
+	free(chunks);
+	chunks = NULL;
+	chunks_w = chunks_h = 0;
+	mem_used[MEM_RENDER] = 0;
+}
+
+/* a map is refused when its two grids, next to held bytes of other maps that stay
+ * resident, exceed the map budget or its chunk cache the render budget */
+static int map_over_budget(size_t w, size_t h, size_t held) {
+	size_t nchunks = ((w + CHUNK_SIZE - 1) >> CHUNK_SHIFT) * ((h + CHUNK_SIZE - 1) >> CHUNK_SHIFT);
+	return (mem_budget[MEM_MAP] && 2 * w * h + held > mem_budget[MEM_MAP]) || (mem_budget[MEM_RENDER] && nchunks * sizeof(Chunk) > mem_budget[MEM_RENDER]);
+}
+
+static void chunk_rebuild(int cx, int cz) {
+	Chunk *c = &chunks[cz * chunks_w + cx];
+	int x0 = cx << CHUNK_SHIFT, z0 = cz << CHUNK_SHIFT;
+	int x1 = x0 + CHUNK_SIZE < map_w ? x0 + CHUNK_SIZE : map_w;
+	int z1 = z0 + CHUNK_SIZE < map_h ? z0 + CHUNK_SIZE : map_h;
+	c->count = 0;
+	for (int z = z0; z < z1; ++z) {
+		const uint8_t *row = map_cells + (size_t) z * map_w;
+		for (int x = x0; x < x1; ++x)
+			if (row[x] != TILE_EMPTY) c->idx[c->count++] = (uint8_t) (((z - z0) << CHUNK_SHIFT) | (x - x0));
+	}
+	c->dirty = 0;
+	c->gen = ++chunk_gen;
+}
+
+/* rebuild every dirty chunk, so a fresh map's first frame doesn't do it */
+static void chunk_cache_build(void) {
+	for (int cz = 0; cz < chunks_h; ++cz)
+		for (int cx = 0; cx < chunks_w; ++cx)
+			if (chunks[cz * chunks_w + cx].dirty) chunk_rebuild(cx, cz);
+}
+
+/* mark every chunk overlapping cells [x0, x1] x [z0, z1] for rebuild */
+static void chunk_invalidate_rect(int x0, int z0, int x1, int z1) {
+	if (!chunks) return;
+	if (x0 < 0) x0 = 0;
+	if (z0 < 0) z0 = 0;
+	if (x1 >= map_w) x1 = map_w - 1;
+	if (z1 >= map_h) z1 = map_h - 1;
+	for (int cz = z0 >> CHUNK_SHIFT; cz <= z1 >> CHUNK_SHIFT; ++cz)
+		for (int cx = x0 >> CHUNK_SHIFT; cx <= x1 >> CHUNK_SHIFT; ++cx) chunks[cz * chunks_w + cx].dirty = 1;
+}
+
+/* ---------------- edit journal (undo/redo) ---------------- */
+/* Each edit operation is stored as runs of consecutive cells that had one old value and
+ * got one new value: {start, len, old, new}. A single placed tile is one run, a box
+ * fill one run per row (or fewer when rows are contiguous and uniform), so undo history
+ * never holds map copies. ops[] indexes the first run of each operation; ops below
+ * journal_cursor are undoable, the rest redoable. Both arrays only grow while their
+ * combined capacity fits the undo memory budget; once full, the oldest operations are
+ * dropped to make room. */
+typedef struct {
+	uint32_t start, len;
+	uint8_t old_type, old_rot, new_type, new_rot;
+} EditRun;
+
+static EditRun *journal_runs = NULL;
+static size_t journal_nruns = 0, journal_runs_cap = 0;
+static uint32_t *journal_ops = NULL; /* first run of each op */
+static size_t journal_nops = 0, journal_ops_cap = 0;
+static size_t journal_cursor = 0;
+static int journal_open = 0;
+static int journal_started = 0; /* the open operation has changed a cell */
+
+static void journal_account(void) { mem_used[MEM_UNDO] = journal_runs_cap * sizeof(EditRun) + journal_ops_cap * sizeof(uint32_t); }
+
+static void journal_clear(void) {
+	free(journal_runs);
+	free(journal_ops);
+	journal_runs = NULL;
+	journal_ops = NULL;
+	journal_nruns = journal_runs_cap = journal_nops = journal_ops_cap = 0;
+	journal_cursor = 0;
+	journal_open = journal_started = 0;
+	journal_account();
+}
+
+/* capacity to grow an array of elem-sized entries to, keeping it and other_bytes inside
+ * the undo budget; returns cap when there is no room to grow */
+static size_t journal_grow_cap(size_t cap, size_t first, size_t elem, size_t other_bytes) {
+	size_t max = SIZE_MAX / elem;
+	if (mem_budget[MEM_UNDO]) {
+		size_t room = mem_budget[MEM_UNDO] > other_bytes ? (mem_budget[MEM_UNDO] - other_bytes) / elem : 0;
+		if (room < max) max = room;
+	}
+	size_t grown = cap ? (cap > max / 2 ? max : cap * 2) : first;
+	if (grown > max) grown = max;
+	return grown > cap ? grown : cap;
+}
+
+/* drop the oldest n finished operations, keeping the open one */
+static void journal_drop_oldest(size_t n) {
+	size_t live = journal_nops + (journal_open && journal_started); /* ops[] entries in use */
+	size_t first = n < live ? journal_ops[n] : journal_nruns;
+	memmove(journal_runs, journal_runs + first, (journal_nruns - first) * sizeof(EditRun));
+	journal_nruns -= first;
+	for (size_t i = n; i < live; ++i) journal_ops[i - n] = journal_ops[i] - (uint32_t) first;
+	journal_nops -= n;
+	journal_cursor = journal_cursor > n ? journal_cursor - n : 0;
+}
+
+/* can't record the open operation: it becomes non-undoable */
+static void journal_abandon(void) {
+	if (journal_started) journal_nruns = journal_ops[journal_nops];
+	journal_open = journal_started = 0;
+}
+
+/* start an operation; the redo history is kept until it actually changes a cell */
+static void journal_begin(void) {
+	journal_open = 1;
+	journal_started = 0;
+}
+
+/* first change of the open operation: anything that was undone can no longer be redone */
+static int journal_start(void) {
+	if (journal_cursor < journal_nops) {
+		journal_nruns = journal_ops[journal_cursor];
+		journal_nops = journal_cursor;
+	}
+	size_t cap = journal_grow_cap(journal_ops_cap, 256, sizeof(uint32_t), journal_runs_cap * sizeof(EditRun));
+	if (journal_nops == journal_ops_cap && cap == journal_ops_cap) {
+		if (journal_nops == 0) return -4;
+		journal_drop_oldest(1);
+	} else if (journal_nops == journal_ops_cap) {
+		uint32_t *ops = (uint32_t *) realloc(journal_ops, cap * sizeof(uint32_t));
+		if (!ops) return -2;
+		journal_ops = ops;
+		journal_ops_cap = cap;
+		journal_account();
+	}
+	journal_ops[journal_nops] = (uint32_t) journal_nruns;
+	journal_started = 1;
+	return 0;
+}
+
+static void journal_note(uint32_t start, uint32_t len, uint8_t old_type, uint8_t old_rot, uint8_t new_type, uint8_t new_rot) {
+	if (!journal_started && journal_start() != 0) {
+		journal_abandon();
+		return;
+	}
+	if (journal_nruns > journal_ops[journal_nops]) {
+		EditRun *last = &journal_runs[journal_nruns - 1];
+		if (last->start + last->len == start && last->old_type == old_type && last->old_rot == old_rot && last->new_type == new_type && last->new_rot == new_rot) {
+			last->len += len;
+			return;
+		}
+	}
+	if (journal_nruns == journal_runs_cap) {
+		/* leave the ops array room for one op per run */
+		size_t ops_share = mem_budget[MEM_UNDO] / (sizeof(EditRun) + sizeof(uint32_t)) * sizeof(uint32_t);
+		if (ops_share < journal_ops_cap * sizeof(uint32_t)) ops_share = journal_ops_cap * sizeof(uint32_t);
+		size_t cap = journal_grow_cap(journal_runs_cap, 1024, sizeof(EditRun), ops_share);
+		while (cap == journal_runs_cap && journal_nops > 0 && journal_nruns == journal_runs_cap) journal_drop_oldest(1);
+		if (journal_nruns < journal_runs_cap) {
+			journal_runs[journal_nruns++] = (EditRun) {start, len, old_type, old_rot, new_type, new_rot};
+			return;
+		}
+		EditRun *runs = cap > journal_runs_cap ? (EditRun *) realloc(journal_runs, cap * sizeof(EditRun)) : NULL;
+		if (!runs) {
+			journal_abandon();
+			return;
+		}
+		journal_runs = runs;
+		journal_runs_cap = cap;
+		journal_account();
+	}
+	journal_runs[journal_nruns++] = (EditRun) {start, len, old_type, old_rot, new_type, new_rot};
+}
+
+static void journal_end(void) {
+	if (!journal_open) return;
+	journal_open = 0;
+	if (!journal_started || journal_nruns == journal_ops[journal_nops]) return; /* nothing changed */
+	journal_cursor = ++journal_nops;
+}
+
+/* ---------------- map storage ---------------- */
+static int map_alloc(Map *m, int w, int h) {
+	size_t n = (size_t) w * h;
+	if (arena_init(&m->mem, 2 * n + ARENA_ALIGN) != 0) return -2;
+	m->w = w;
+	m->h = h;
+	m->cells = (uint8_t *) arena_alloc(&m->mem, n);
+	m->rots = (uint8_t *) arena_alloc(&m->mem, n);
+	memset(m->cells, TILE_EMPTY, n);
+	memset(m->rots, 0, n);
+	return 0;
+}
+
+static void map_free(Map *m) {
+	arena_free(&m->mem);
+	m->cells = m->rots = NULL;
+	m->w = m->h = 0;
+}
+
+/* make m the current map, releasing the previous one; m is left empty */
+static void map_install(Map *m) {
+	map_free(&cur_map);
+	cur_map = *m;
+	memset(m, 0, sizeof(*m));
+	map_w = cur_map.w;
+	map_h = cur_map.h;
+	map_cells = cur_map.cells;
+	map_rots = cur_map.rots;
+	mem_used[MEM_MAP] = cur_map.mem.cap + map_side_bytes;
+	chunk_cache_reset();
+	journal_clear();
+	map_edit_serial = map_saved_serial = map_autosaved_serial = 0;
+	autosave_last = now_seconds();
+	sel_state = 0; /* a selection belongs to the map it was made on */
+}
+
+/* ---------------- binary map format ---------------- */
+/* "JMAP", version, width, height (native-endian uint32), then the cells grid and the
+ * rots grid, row-major. Loads straight into the map's arena with no parsing. */
+#define MAP_BIN_MAGIC "JMAP"
+#define MAP_BIN_VERSION 1
+
+typedef struct {
+	char magic[4];
+	uint32_t version, w, h;
+} MapFileHeader;
+
+/* read exactly n bytes, retrying interrupted and partial reads; -1 on error or early EOF */
+static int read_all(int fd, void *data, size_t n) {
+	char *p = (char *) data;
+	while (n) {
+		ssize_t r = read(fd, p, n);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return -1;
+		p += r;
+		n -= (size_t) r;
+	}
+	return 0;
+}
+
+static int load_map_binary(int fd, const MapFileHeader *bh, size_t sz, size_t held, Map *out) {
+	if (bh->version != MAP_BIN_VERSION || bh->w == 0 || bh->h == 0 || bh->w > 65536 || bh->h > 65536) return -3;
+	size_t n = (size_t) bh->w * bh->h;
+	if (sz < sizeof(*bh) + 2 * n) return -3;
+	if (map_over_budget(bh->w, bh->h, held)) return -4;
+	if (map_alloc(out, (int) bh->w, (int) bh->h) != 0) return -2;
+	if (read_all(fd, out->cells, n) != 0 || read_all(fd, out->rots, n) != 0) {
+		map_free(out);
+		return -3;
+	}
+	return 0;
+}
 
 /* ---------------- JSON-like loader (supports [type, rot] per cell) ---------------- */
-static int load_map_json_like(const char *path) {
-	FILE *f = fopen(path, "rb");
-	if (!f) return -1;
-	fseek(f, 0, SEEK_END);
-	long sz = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	char *buf = (char *) malloc(sz + 1);
-	if (!buf) {
-		fclose(f);
+/* Parses into out without touching the current map. The file text and the staging
+ * grid share one scratch arena sized from the file (every cell takes at least one
+ * character and every row at least two), so a load is one scratch block plus the map's
+ * own block, and the scratch is released in one free. held is the map memory that stays
+ * resident next to the result (see map_over_budget). */
+static int load_map_beside(const char *path, size_t held, Map *out) {
+	memset(out, 0, sizeof(*out));
+	/* size via fstat and read straight into the buffer with no stdio copy; the only seek
+	 * is back to the start when the file turns out not to be binary */
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < 0) {
+		close(fd);
+		return -1;
+	}
+	size_t sz = (size_t) st.st_size;
+	MapFileHeader bh;
+	if (sz >= sizeof(bh) && read_all(fd, &bh, sizeof(bh)) == 0 && memcmp(bh.magic, MAP_BIN_MAGIC, 4) == 0) {
+		int res = load_map_binary(fd, &bh, sz, held, out);
+		close(fd);
+		return res;
+	}
+	if (lseek(fd, 0, SEEK_SET) != 0) {
+		close(fd);
+		return -1;
+	}
+	size_t max_cells = sz + 1, max_rows = sz / 2 + 1;
+	Arena scratch;
+	if (arena_init(&scratch, (sz + 1) + 2 * max_cells + (max_rows + 1) * sizeof(uint32_t) + 4 * ARENA_ALIGN) != 0) {
+		close(fd);
 		return -2;
 	}
-	fread(buf, 1, sz, f);
+	char *buf = (char *) arena_alloc(&scratch, sz + 1);
+	uint8_t *stage_types = (uint8_t *) arena_alloc(&scratch, max_cells);
+	uint8_t *stage_rots = (uint8_t *) arena_alloc(&scratch, max_cells);
+	uint32_t *row_start = (uint32_t *) arena_alloc(&scratch, (max_rows + 1) * sizeof(uint32_t));
+	int read_res = read_all(fd, buf, sz);
+	close(fd);
+	if (read_res != 0) {
+		/* an error or a file that shrank under us: don't parse a partial map */
+		arena_free(&scratch);
+		return -1;
+	}
 	buf[sz] = '\0';
-	fclose(f);
 
 	int w = 0, h = 0;
+	int rows = -1, widest = 0;
+	size_t ncells = 0;
+	uint32_t wrapped_rots = 0;
 	char *p = buf;
 	while (*p) {
 		if (strncmp(p, "\"width\"", 7) == 0 || strncmp(p, "width", 5) == 0) {
@@ -128,23 +599,20 @@ static int load_map_json_like(const char *path) {
 			while (*p && *p != '[') ++p;
 			if (!*p) break;
 			++p;
-			int row = 0, col = 0;
-			int tmpw = 128, tmph = 128;
-			uint8_t *tmp_types = (uint8_t *) calloc(tmpw * tmph, 1);
-			uint8_t *tmp_rots = (uint8_t *) calloc(tmpw * tmph, 0);
-			while (*p && row < 10000) {
+			int row = 0;
+			while (*p && (size_t) row < max_rows) {
 				while (*p && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' || *p == ',')) ++p;
 				if (!*p) break;
 				if (*p == '[') {
 					++p;
-					col = 0;
+					row_start[row] = (uint32_t) ncells;
 					while (*p && *p != ']') {
 						while (*p && (*p == ' ' || *p == ',' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
 						if (!*p || *p == ']') break;
+						int type = 0, rot = 0;
 						if (*p == '[') {
 							++p;
 							while (*p && (*p == ' ' || *p == ',')) ++p;
-							int type = 0, rot = 0;
 							if (*p == '-' || (*p >= '0' && *p <= '9')) {
 								type = atoi(p);
 								while (*p && ((*p >= '0' && *p <= '9') || *p == '-')) ++p;
@@ -156,30 +624,27 @@ static int load_map_json_like(const char *path) {
 							}
 							while (*p && *p != ']') ++p;
 							if (*p == ']') ++p;
-							if (row < tmph && col < tmpw) {
-								tmp_types[row * tmpw + col] = (uint8_t) type;
-								tmp_rots[row * tmpw + col] = (uint8_t) (rot & 3);
-							}
-							++col;
 						} else {
-							int val = 0;
 							int sign = 1;
 							if (*p == '-') {
 								sign = -1;
 								++p;
 							}
 							if (*p >= '0' && *p <= '9') {
-								val = atoi(p) * sign;
+								type = atoi(p) * sign;
 								while (*p && ((*p >= '0' && *p <= '9') || *p == '-')) ++p;
 							} else
 								++p;
-							if (row < tmph && col < tmpw) {
-								tmp_types[row * tmpw + col] = (uint8_t) val;
-								tmp_rots[row * tmpw + col] = 0;
-							}
-							++col;
+						}
+						if (ncells < max_cells) {
+							stage_types[ncells] = type >= 0 && type <= 0xff ? (uint8_t) type : 0xff; /* never wrap into a real tile */
+							stage_rots[ncells] = (uint8_t) (rot & 3);
+							if (rot & ~3) ++wrapped_rots;
+							++ncells;
 						}
 					}
+					int len = (int) (ncells - row_start[row]);
+					if (len > widest) widest = len;
 					++row;
 					while (*p && *p != ']') ++p;
 					if (*p == ']') ++p;
@@ -189,47 +654,283 @@ static int load_map_json_like(const char *path) {
 				} else
 					++p;
 			}
-			if (w <= 0) w = tmpw;
-			if (h <= 0) h = row;
-			if (tmp_types) {
-				map_w = w;
-				map_h = h;
-				if (map_cells) free(map_cells);
-				if (map_rots) free(map_rots);
-				map_cells = (uint8_t *) malloc(map_w * map_h);
-				map_rots = (uint8_t *) malloc(map_w * map_h);
-				for (int rz = 0; rz < map_h; ++rz)
-					for (int rx = 0; rx < map_w; ++rx) {
-						uint8_t v = 0, r = 0;
-						if (rz < tmph && rx < tmpw) {
-							v = tmp_types[rz * tmpw + rx];
-							r = tmp_rots[rz * tmpw + rx];
-						}
-						map_cells[rz * map_w + rx] = v;
-						map_rots[rz * map_w + rx] = r;
-					}
-				free(tmp_types);
-				free(tmp_rots);
-			}
+			row_start[row] = (uint32_t) ncells;
+			rows = row;
 			break;
 		} else
 			++p;
 	}
+
+	/* short rows are padded, but a declared size must stay within the binary format's
+	 * limits and have at least one byte of the file behind every cell (a written map
+	 * takes two or more), so a bad header can't demand a huge grid */
+	int res = -3;
+	if (rows >= 0) {
+		if (w <= 0) w = widest;
+		if (h <= 0) h = rows;
+		if (w > 0 && h > 0 && w <= 65536 && h <= 65536 && (size_t) w * h <= sz) res = map_over_budget((size_t) w, (size_t) h, held) ? -4 : map_alloc(out, w, h);
+	}
+	if (res == 0) {
+		/* row-wise copy; cells beyond a short row or past the last row stay empty */
+		for (int rz = 0; rz < h && rz < rows; ++rz) {
+			size_t len = row_start[rz + 1] - row_start[rz];
+			if (len > (size_t) w) len = (size_t) w;
+			memcpy(out->cells + (size_t) rz * w, stage_types + row_start[rz], len);
+			memcpy(out->rots + (size_t) rz * w, stage_rots + row_start[rz], len);
+			if (row_start[rz + 1] - row_start[rz] != (size_t) w) out->ragged_rows++;
+		}
+		if (rows != h) out->ragged_rows += (uint32_t) abs(rows - h);
+		out->wrapped_rots = wrapped_rots;
+	}
+	arena_free(&scratch);
+	return res;
+}
+
+/* load a map that will replace the current one */
+static int load_map_file(const char *path, Map *out) { return load_map_beside(path, 0, out); }
+
+/* load a map file and make it current; the current map is kept on failure */
+static int load_map_json_like(const char *path) {
+	Map m;
+	int res = load_map_file(path, &m);
+	if (res == 0) {
+		map_install(&m);
+		snprintf(map_path, sizeof(map_path), "%s", path);
+	}
+	return res;
+}
+
+/* ---------------- map writer (JSON and binary, atomic replace) ---------------- */
+/* Maps are written to "<path>.tmp", fsynced, renamed over the target and the directory
+ * fsynced, so a crash leaves either the old file or the new one, never a torn one.
+ * map_save_async snapshots the grids on the calling thread and writes from a worker,
+ * so saving a large map doesn't hitch the frame. */
+static int write_all(int fd, const void *data, size_t n) {
+	const char *p = (const char *) data;
+	while (n) {
+		ssize_t w = write(fd, p, n);
+		if (w < 0 && errno == EINTR) continue;
+		if (w <= 0) return -1;
+		p += w;
+		n -= (size_t) w;
+	}
+	return 0;
+}
+
+static int map_write_binary(int fd, int w, int h, const uint8_t *cells, const uint8_t *rots) {
+	MapFileHeader bh;
+	memcpy(bh.magic, MAP_BIN_MAGIC, 4);
+	bh.version = MAP_BIN_VERSION;
+	bh.w = (uint32_t) w;
+	bh.h = (uint32_t) h;
+	size_t n = (size_t) w * h;
+	if (write_all(fd, &bh, sizeof(bh)) != 0 || write_all(fd, cells, n) != 0 || write_all(fd, rots, n) != 0) return -1;
+	return 0;
+}
+
+/* JSON goes through one fixed output buffer flushed with write(); numbers are formatted
+ * by hand (cells are bytes, so at most three digits). Pretty puts one row per line, as
+ * the editor saves; compact drops all whitespace. */
+#define JSON_OUT_BUF (1 << 20)
+
+static char *put_uint(char *o, unsigned v) {
+	char tmp[10];
+	int n = 0;
+	do {
+		tmp[n++] = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v);
+	while (n) *o++ = tmp[--n];
+	return o;
+}
+
+static inline char *put_u8(char *o, unsigned v) {
+	if (v >= 100) {
+		*o++ = (char) ('0' + v / 100);
+		v %= 100;
+		*o++ = (char) ('0' + v / 10);
+	} else if (v >= 10)
+		*o++ = (char) ('0' + v / 10);
+	*o++ = (char) ('0' + v % 10);
+	return o;
+}
+
+static char *put_str(char *o, const char *s) {
+	size_t n = strlen(s);
+	memcpy(o, s, n);
+	return o + n;
+}
+
+static int map_write_json(int fd, int w, int h, const uint8_t *cells, const uint8_t *rots, int pretty) {
+	char *buf = (char *) malloc(JSON_OUT_BUF);
+	if (!buf) return -2;
+	const char *sep = pretty ? ", " : ",";
+	size_t seplen = pretty ? 2 : 1;
+	char *o = buf, *limit = buf + JSON_OUT_BUF - 64; /* room for any single cell or row end */
+	int res = 0;
+	o = put_str(o, pretty ? "{\n    \"width\": " : "{\"width\":");
+	o = put_uint(o, (unsigned) w);
+	o = put_str(o, pretty ? ",\n    \"height\": " : ",\"height\":");
+	o = put_uint(o, (unsigned) h);
+	o = put_str(o, pretty ? ",\n    \"cells\": [\n" : ",\"cells\":[");
+	for (int z = 0; z < h && res == 0; ++z) {
+		if (pretty) o = put_str(o, "        ");
+		*o++ = '[';
+		const uint8_t *rc = cells + (size_t) z * w, *rr = rots + (size_t) z * w;
+		for (int x = 0; x < w; ++x) {
+			if (x) {
+				memcpy(o, sep, seplen);
+				o += seplen;
+			}
+			/* wedges (and anything carrying a rotation) as [type, rot] */
+			if (rc[x] == TILE_WEDGE || rr[x]) {
+				*o++ = '[';
+				o = put_u8(o, rc[x]);
+				memcpy(o, sep, seplen);
+				o += seplen;
+				o = put_u8(o, rr[x]);
+				*o++ = ']';
+			} else
+				o = put_u8(o, rc[x]);
+			if (o > limit) {
+				if (write_all(fd, buf, (size_t) (o - buf)) != 0) {
+					res = -1;
+					break;
+				}
+				o = buf;
+			}
+		}
+		*o++ = ']';
+		if (z + 1 < h) *o++ = ',';
+		if (pretty) *o++ = '\n';
+	}
+	o = put_str(o, pretty ? "    ]\n}\n" : "]}\n");
+	if (res == 0 && write_all(fd, buf, (size_t) (o - buf)) != 0) res = -1;
 	free(buf);
-	if (!map_cells) return -3;
+	return res;
+}
+
+static int path_is_binary(const char *path) {
+	size_t n = strlen(path);
+	return n >= 5 && strcmp(path + n - 5, ".jmap") == 0;
+}
+
+static int map_save_file(const char *path, int w, int h, const uint8_t *cells, const uint8_t *rots, int pretty) {
+	char tmp[620];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return -1;
+	int res = path_is_binary(path) ? map_write_binary(fd, w, h, cells, rots) : map_write_json(fd, w, h, cells, rots, pretty);
+	if (res == 0 && fsync(fd) != 0) res = -1;
+	close(fd);
+	if (res == 0 && rename(tmp, path) != 0) res = -1;
+	if (res != 0) {
+		unlink(tmp);
+		return res;
+	}
+	/* make the rename itself durable */
+	char dir[600];
+	snprintf(dir, sizeof(dir), "%s", path);
+	char *slash = strrchr(dir, '/');
+	if (slash) *(slash == dir ? slash + 1 : slash) = '\0';
+	else
+		snprintf(dir, sizeof(dir), ".");
+	int dfd = open(dir, O_RDONLY);
+	if (dfd >= 0) {
+		fsync(dfd);
+		close(dfd);
+	}
+	return 0;
+}
+
+typedef struct {
+	char path[sizeof(map_path)];
+	int w, h;
+	uint8_t *grid; /* snapshot: w*h cells then w*h rots; NULL when written in place */
+	int result;
+} SaveJob;
+
+static SaveJob *save_job = NULL;
+static SDL_Thread *save_thread = NULL;
+static SDL_atomic_t save_done;
+
+static int save_thread_main(void *data) {
+	SaveJob *job = (SaveJob *) data;
+	size_t n = (size_t) job->w * job->h;
+	job->result = map_save_file(job->path, job->w, job->h, job->grid, job->grid + n, 1);
+	SDL_AtomicSet(&save_done, 1);
+	return 0;
+}
+
+/* snapshot the current map and write it in the background; -1 if a save is in flight.
+ * The snapshot counts under MEM_MAP until the save is reaped; when it would not fit the
+ * map budget the map is written from the live grids on this thread instead. */
+static int map_save_async(const char *path) {
+	if (save_job) return -1;
+	ALLOC_EXPECTED(); /* the snapshot and the thread */
+	size_t n = (size_t) map_w * map_h;
+	SaveJob *job = (SaveJob *) malloc(sizeof(SaveJob));
+	if (!job) return -2;
+	snprintf(job->path, sizeof(job->path), "%s", path);
+	job->w = map_w;
+	job->h = map_h;
+	job->grid = NULL;
+	job->result = 0;
+	if (mem_over(MEM_MAP, 2 * n)) {
+		job->result = map_save_file(job->path, map_w, map_h, map_cells, map_rots, 1);
+		SDL_AtomicSet(&save_done, 1);
+		save_job = job;
+		return 0;
+	}
+	uint8_t *grid = (uint8_t *) malloc(2 * n);
+	if (!grid) {
+		free(job);
+		return -2;
+	}
+	memcpy(grid, map_cells, n);
+	memcpy(grid + n, map_rots, n);
+	job->grid = grid;
+	SDL_AtomicSet(&save_done, 0);
+	save_thread = SDL_CreateThread(save_thread_main, "map-save", job);
+	if (!save_thread) {
+		free(grid);
+		free(job);
+		return -2;
+	}
+	map_side_bytes += 2 * n;
+	mem_used[MEM_MAP] += 2 * n;
+	save_job = job;
 	return 0;
 }
 
+/* reap a finished save: returns 1 with its result and the path it wrote when one
+ * completed, 0 otherwise; wait blocks for an in-flight save (used on exit) */
+static int map_save_poll(int wait, int *result, char *path, size_t n) {
+	if (!save_job || (!wait && !SDL_AtomicGet(&save_done))) return 0;
+	ALLOC_EXPECTED(); /* joining the thread frees it */
+	if (save_thread) {
+		SDL_WaitThread(save_thread, NULL);
+		save_thread = NULL;
+	}
+	*result = save_job->result;
+	snprintf(path, n, "%s", save_job->path);
+	if (save_job->grid) {
+		size_t bytes = 2 * (size_t) save_job->w * save_job->h;
+		map_side_bytes -= bytes;
+		mem_used[MEM_MAP] -= bytes;
+	}
+	free(save_job->grid);
+	free(save_job);
+	save_job = NULL;
+	return 1;
+}
+
 /* demo map */
 static void generate_demo_map(void) {
-	map_w = 32;
-	map_h = 32;
-	if (map_cells) free(map_cells);
-	if (map_rots) free(map_rots);
-	map_cells = (uint8_t *) malloc(map_w * map_h);
-	map_rots = (uint8_t *) malloc(map_w * map_h);
-	memset(map_cells, TILE_EMPTY, map_w * map_h);
-	memset(map_rots, 0, map_w * map_h);
+	Map m;
+	if (map_alloc(&m, 32, 32) != 0) return;
+	map_install(&m);
+	map_path[0] = '\0';
 	for (int z = 0; z < map_h; ++z)
 		for (int x = 0; x < map_w; ++x)
 			if (z == 0 || x == 0 || z == map_h - 1 || x == map_w - 1) map_cells[z * map_w + x] = TILE_CUBE;
@@ -247,6 +948,503 @@ static void generate_demo_map(void) {
 	map_cells[(map_h / 2) * map_w + (map_w / 2)] = TILE_END;
 }
 
+/* ---------------- procedural course generator ---------------- */
+/* The map is cut into 16x16 rooms visited in serpentine order (left to right, then
+ * right to left on the next row). Each room routes a line of 1-high pads from its entry
+ * through a random waypoint to its exit. Everything a room needs comes from hashes of
+ * the seed: the crossing point on the edge shared by rooms k and k+1 hashes k, so both
+ * sides agree without talking to each other, and bands of room rows are generated on
+ * separate threads writing disjoint rows. Gaps between pads never exceed what a
+ * running jump covers (see gen_max_gap). */
+#define GEN_ROOM 16
+#define GEN_MIN_SIZE (2 * GEN_ROOM)
+#define GEN_MAX_SIZE 16384
+#define GEN_MAX_THREADS 16
+#define GEN_MENU_SIZE 128
+
+/* a seed argument (decimal, or hex with 0x); the game and --check both parse seeds
+ * here, so a seed names the same course in either */
+static uint32_t parse_seed(const char *s) { return (uint32_t) strtoul(s, NULL, 0); }
+
+typedef struct {
+	uint32_t seed;
+	int rooms_x, rooms_z, max_gap; /* rooms_z 0: endless, no end tile */
+	Map *m;
+	int z0, z1; /* band of map rows this worker owns */
+	int rz0, rz1; /* band of room rows */
+	long oz; /* room row stored at map row 0 (streamed courses) */
+} GenBand;
+
+static uint64_t gen_hash(uint64_t seed, uint64_t a, uint64_t b) {
+	uint64_t x = seed * 0x9e3779b97f4a7c15ull ^ a * 0xbf58476d1ce4e5b9ull ^ b * 0x94d049bb133111ebull;
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+static uint32_t gen_next(uint64_t *state) {
+	*state = gen_hash(*state, 1, 0);
+	return (uint32_t) (*state >> 32);
+}
+
+/* widest gap (in cells) between two pads: a jump from pad top back to pad top stays in
+ * the air 2*v/g seconds at up to MAX_WALK_SPEED; keep 60% of that for slow starts and
+ * diagonal take-offs */
+static int gen_max_gap(void) {
+	double reach = MAX_WALK_SPEED * 2.0 * JUMP_VELOCITY / GRAVITY;
+	int gap = (int) floor(reach * 0.6);
+	if (gap < 1) gap = 1;
+	if (gap > GEN_ROOM / 4) gap = GEN_ROOM / 4;
+	return gap;
+}
+
+static void gen_room_pos(const GenBand *b, long k, int *rx, int *rz) {
+	*rz = (int) (k / b->rooms_x);
+	int i = (int) (k % b->rooms_x);
+	*rx = (*rz & 1) ? b->rooms_x - 1 - i : i;
+}
+
+/* point where the course crosses from room k into room k+1, on room k's side when
+ * exit is set and on room k+1's side otherwise */
+static void gen_crossing(const GenBand *b, long k, int exit, int *x, int *z) {
+	int ax, az, bx, bz;
+	gen_room_pos(b, k, &ax, &az);
+	gen_room_pos(b, k + 1, &bx, &bz);
+	int off = 2 + (int) (gen_hash(b->seed, (uint64_t) k, 2) % (GEN_ROOM - 4));
+	int rx = exit ? ax : bx, rz = exit ? az : bz;
+	if (az == bz) {
+		int east = (bx > ax) == exit; /* the crossing lies on this room's east edge */
+		*x = rx * GEN_ROOM + (east ? GEN_ROOM - 1 : 0);
+		*z = rz * GEN_ROOM + off;
+	} else {
+		*x = rx * GEN_ROOM + off;
+		*z = rz * GEN_ROOM + (exit ? GEN_ROOM - 1 : 0);
+	}
+}
+
+static void gen_pad(Map *m, int x, int z, int rx, int rz, int dx, int dz, uint64_t *rng) {
+	size_t i = (size_t) z * m->w + x;
+	uint32_t r = gen_next(rng) % 100;
+	if (r < 15) {
+		/* wedge rising along the direction of travel */
+		m->cells[i] = TILE_WEDGE;
+		m->rots[i] = abs(dx) >= abs(dz) ? (dx >= 0 ? 0 : 1) : (dz >= 0 ? 2 : 3);
+	} else if (r < 30 && x + 1 < (rx + 1) * GEN_ROOM && z + 1 < (rz + 1) * GEN_ROOM) {
+		m->cells[i] = m->cells[i + 1] = m->cells[i + m->w] = m->cells[i + m->w + 1] = TILE_CUBE;
+	} else
+		m->cells[i] = TILE_CUBE;
+}
+
+/* pads from (x0,z0) towards (x1,z1); the pad at the far end is left to the caller */
+static void gen_segment(Map *m, int x0, int z0, int x1, int z1, int rx, int rz, int max_gap, uint64_t *rng) {
+	int x = x0, z = z0;
+	for (;;) {
+		double dx = x1 - x, dz = z1 - z, d = sqrt(dx * dx + dz * dz);
+		if (d <= max_gap + 1) return;
+		int step = 2 + (int) (gen_next(rng) % (uint32_t) max_gap), sx, sz;
+		/* rounding to cells can stretch a diagonal jump; shorten until the edge-to-edge
+		 * gap fits */
+		for (;; --step) {
+			sx = (int) lround(dx / d * step);
+			sz = (int) lround(dz / d * step);
+			int gx = abs(sx) > 1 ? abs(sx) - 1 : 0, gz = abs(sz) > 1 ? abs(sz) - 1 : 0;
+			if (gx * gx + gz * gz <= max_gap * max_gap || step <= 2) break;
+		}
+		x += sx;
+		z += sz;
+		gen_pad(m, x, z, rx, rz, (int) dx, (int) dz, rng);
+	}
+}
+
+static void gen_room(const GenBand *b, int rx, int rz) {
+	Map *m = b->m;
+	long k = (long) rz * b->rooms_x + ((rz & 1) ? b->rooms_x - 1 - rx : rx);
+	long last = (long) b->rooms_x * b->rooms_z - 1; /* -1 when endless */
+	uint64_t rng = gen_hash(b->seed, (uint64_t) k, 1);
+	int ax, az, bx, bz;
+	if (k == 0) {
+		ax = 3; /* the spawn point; the player starts on the floor here */
+		az = 3;
+	} else
+		gen_crossing(b, k - 1, 0, &ax, &az);
+	if (k == last) {
+		bx = rx * GEN_ROOM + 2 + (int) (gen_next(&rng) % (GEN_ROOM - 4));
+		bz = rz * GEN_ROOM + 2 + (int) (gen_next(&rng) % (GEN_ROOM - 4));
+	} else
+		gen_crossing(b, k, 1, &bx, &bz);
+	int cx = rx * GEN_ROOM + 2 + (int) (gen_next(&rng) % (GEN_ROOM - 4));
+	int cz = rz * GEN_ROOM + 2 + (int) (gen_next(&rng) % (GEN_ROOM - 4));
+	/* to map rows */
+	int oz = (int) (b->oz * GEN_ROOM);
+	az -= oz;
+	bz -= oz;
+	cz -= oz;
+	rz -= (int) b->oz;
+	if (k != 0) m->cells[(size_t) az * m->w + ax] = TILE_CUBE;
+	gen_segment(m, ax, az, cx, cz, rx, rz, b->max_gap, &rng);
+	gen_pad(m, cx, cz, rx, rz, cx - ax, cz - az, &rng);
+	gen_segment(m, cx, cz, bx, bz, rx, rz, b->max_gap, &rng);
+	size_t end = (size_t) bz * m->w + bx;
+	m->cells[end] = k == last ? TILE_END : TILE_CUBE;
+	m->rots[end] = 0;
+}
+
+static int gen_band_main(void *data) {
+	const GenBand *b = (const GenBand *) data;
+	Map *m = b->m;
+	for (int z = b->z0; z < b->z1; ++z) {
+		uint8_t *row = m->cells + (size_t) z * m->w;
+		if (z == 0 || z == m->h - 1) memset(row, TILE_CUBE, m->w);
+		row[0] = row[m->w - 1] = TILE_CUBE;
+	}
+	for (int rz = b->rz0; rz < b->rz1; ++rz)
+		for (int rx = 0; rx < b->rooms_x; ++rx) gen_room(b, rx, rz);
+	return 0;
+}
+
+/* generate a size x size course into out; -2 alloc, -3 bad size, -4 over a budget */
+static int generate_course(uint32_t seed, int size, Map *out) {
+	memset(out, 0, sizeof(*out));
+	if (size < GEN_MIN_SIZE || size > GEN_MAX_SIZE) return -3;
+	if (map_over_budget((size_t) size, (size_t) size, 0)) return -4;
+	if (map_alloc(out, size, size) != 0) return -2;
+	GenBand base = {seed, size / GEN_ROOM, size / GEN_ROOM, gen_max_gap(), out, 0, 0, 0, 0, 0};
+	int nthreads = SDL_GetCPUCount();
+	if (nthreads > GEN_MAX_THREADS) nthreads = GEN_MAX_THREADS;
+	if (nthreads > base.rooms_z) nthreads = base.rooms_z;
+	if (nthreads < 1) nthreads = 1;
+	GenBand bands[GEN_MAX_THREADS];
+	SDL_Thread *threads[GEN_MAX_THREADS] = {0};
+	for (int t = 0; t < nthreads; ++t) {
+		bands[t] = base;
+		bands[t].rz0 = base.rooms_z * t / nthreads;
+		bands[t].rz1 = base.rooms_z * (t + 1) / nthreads;
+		bands[t].z0 = bands[t].rz0 * GEN_ROOM;
+		bands[t].z1 = t == nthreads - 1 ? size : bands[t].rz1 * GEN_ROOM;
+	}
+	/* band 0 runs here; a band whose thread cannot start runs here too */
+	for (int t = 1; t < nthreads; ++t)
+		if (!(threads[t] = SDL_CreateThread(gen_band_main, "course-gen", &bands[t]))) gen_band_main(&bands[t]);
+	gen_band_main(&bands[0]);
+	for (int t = 1; t < nthreads; ++t)
+		if (threads[t]) SDL_WaitThread(threads[t], NULL);
+	return 0;
+}
+
+static int generate_course_map(uint32_t seed, int size) {
+	Map m;
+	double t0 = now_seconds();
+	int res = generate_course(seed, size, &m);
+	if (res != 0) return res;
+	map_install(&m);
+	map_path[0] = '\0';
+	fprintf(stderr, "Generated course: seed %u, %dx%d in %.1f ms\n", seed, size, size, (now_seconds() - t0) * 1000.0);
+	return 0;
+}
+
+/* ---------------- endless streamed course ---------------- */
+/* The endless course is the generator's serpentine with no last room, four rooms wide
+ * and running towards +z forever. The map is a fixed window of STREAM_SEGS room rows
+ * ("segments"). Worker threads fill a ring of STREAM_AHEAD segment slots ahead of the
+ * window; once the player is more than STREAM_BEHIND segments in, the window drops its
+ * first segment, takes the next ready one from the ring, and everything shifts back by
+ * one segment (player, camera and chunk cache rows). If the next segment is not ready
+ * yet the shift simply waits a frame: the window still holds several segments ahead,
+ * so the main thread never waits on a worker. Memory stays at one window plus the ring. */
+#define STREAM_ROOMS_X 4
+#define STREAM_W (STREAM_ROOMS_X * GEN_ROOM)
+#define STREAM_SEGS 12
+#define STREAM_BEHIND 3
+#define STREAM_AHEAD 8
+#define STREAM_WORKERS 2
+
+enum { SEG_FREE,
+	   SEG_QUEUED,
+	   SEG_BUSY,
+	   SEG_READY };
+
+typedef struct {
+	long seg;
+	SDL_atomic_t state;
+	uint8_t cells[STREAM_W * GEN_ROOM];
+	uint8_t rots[STREAM_W * GEN_ROOM];
+} StreamSlot;
+
+static int stream_active = 0;
+static uint32_t stream_seed = 0;
+static long stream_base = 0; /* segment at map row 0 */
+static StreamSlot stream_slots[STREAM_AHEAD];
+static SDL_Thread *stream_threads[STREAM_WORKERS];
+static SDL_sem *stream_work = NULL; /* one post per queued slot */
+static SDL_atomic_t stream_quit;
+
+/* generate segment seg into a STREAM_W x GEN_ROOM grid */
+static void stream_gen_segment(long seg, uint8_t *cells, uint8_t *rots) {
+	Map view;
+	memset(&view, 0, sizeof(view));
+	view.w = STREAM_W;
+	view.h = GEN_ROOM;
+	view.cells = cells;
+	view.rots = rots;
+	memset(cells, TILE_EMPTY, STREAM_W * GEN_ROOM);
+	memset(rots, 0, STREAM_W * GEN_ROOM);
+	for (int z = 0; z < GEN_ROOM; ++z) cells[z * STREAM_W] = cells[z * STREAM_W + STREAM_W - 1] = TILE_CUBE;
+	if (seg == 0) memset(cells, TILE_CUBE, STREAM_W);
+	GenBand b = {stream_seed, STREAM_ROOMS_X, 0, gen_max_gap(), &view, 0, GEN_ROOM, (int) seg, (int) seg + 1, seg};
+	for (int rx = 0; rx < STREAM_ROOMS_X; ++rx) gen_room(&b, rx, (int) seg);
+}
+
+static int stream_worker_main(void *data) {
+	(void) data;
+	for (;;) {
+		SDL_SemWait(stream_work);
+		if (SDL_AtomicGet(&stream_quit)) break;
+		for (int i = 0; i < STREAM_AHEAD; ++i) {
+			StreamSlot *sl = &stream_slots[i];
+			if (!SDL_AtomicCAS(&sl->state, SEG_QUEUED, SEG_BUSY)) continue;
+			stream_gen_segment(sl->seg, sl->cells, sl->rots);
+			SDL_AtomicSet(&sl->state, SEG_READY);
+			break;
+		}
+	}
+	return 0;
+}
+
+static void stream_stop(void) {
+	if (!stream_active) return;
+	SDL_AtomicSet(&stream_quit, 1);
+	for (int t = 0; t < STREAM_WORKERS; ++t) SDL_SemPost(stream_work);
+	for (int t = 0; t < STREAM_WORKERS; ++t)
+		if (stream_threads[t]) SDL_WaitThread(stream_threads[t], NULL);
+	SDL_DestroySemaphore(stream_work);
+	stream_work = NULL;
+	stream_active = 0;
+}
+
+/* install the first window (generated here, once) and start the workers */
+static int stream_start(uint32_t seed) {
+	stream_stop();
+	Map m;
+	if (map_alloc(&m, STREAM_W, STREAM_SEGS * GEN_ROOM) != 0) return -2;
+	stream_seed = seed;
+	stream_base = 0;
+	for (int s = 0; s < STREAM_SEGS; ++s) stream_gen_segment(s, m.cells + (size_t) s * GEN_ROOM * STREAM_W, m.rots + (size_t) s * GEN_ROOM * STREAM_W);
+	map_install(&m);
+	map_path[0] = '\0';
+	stream_work = SDL_CreateSemaphore(0);
+	if (!stream_work) return -2;
+	SDL_AtomicSet(&stream_quit, 0);
+	for (int i = 0; i < STREAM_AHEAD; ++i) {
+		long seg = STREAM_SEGS + i;
+		StreamSlot *sl = &stream_slots[seg % STREAM_AHEAD];
+		sl->seg = seg;
+		SDL_AtomicSet(&sl->state, SEG_QUEUED);
+		SDL_SemPost(stream_work);
+	}
+	stream_active = 1;
+	for (int t = 0; t < STREAM_WORKERS; ++t) stream_threads[t] = SDL_CreateThread(stream_worker_main, "course-stream", NULL);
+	if (!stream_threads[0]) {
+		/* no worker at all: the course would stall at the end of the window */
+		stream_stop();
+		return -2;
+	}
+	return 0;
+}
+
+/* called once per frame with the player's z; returns how far (in cells) the world
+ * moved back, which the caller subtracts from every z it holds */
+static int stream_advance(double pz) {
+	if (!stream_active || (int) floor(pz) < (STREAM_BEHIND + 1) * GEN_ROOM) return 0;
+	long want = stream_base + STREAM_SEGS;
+	StreamSlot *sl = &stream_slots[want % STREAM_AHEAD];
+	if (sl->seg != want || SDL_AtomicGet(&sl->state) != SEG_READY) return 0;
+	size_t seg_cells = (size_t) GEN_ROOM * map_w, keep = (size_t) map_w * map_h - seg_cells;
+	memmove(map_cells, map_cells + seg_cells, keep);
+	memmove(map_rots, map_rots + seg_cells, keep);
+	memcpy(map_cells + keep, sl->cells, seg_cells);
+	memcpy(map_rots + keep, sl->rots, seg_cells);
+	memset(map_cells, TILE_CUBE, map_w); /* wall off the discarded course behind */
+	sl->seg = want + STREAM_AHEAD;
+	SDL_AtomicSet(&sl->state, SEG_QUEUED);
+	SDL_SemPost(stream_work);
+	stream_base++;
+	/* a segment is a whole number of chunk rows: shift the cache, rebuild only the
+	 * new rows and the walled first row */
+	int crows = GEN_ROOM >> CHUNK_SHIFT;
+	if (chunks && chunks_h > crows) {
+		memmove(chunks, chunks + (size_t) crows * chunks_w, (size_t) (chunks_h - crows) * chunks_w * sizeof(Chunk));
+		for (int i = (chunks_h - crows) * chunks_w; i < chunks_h * chunks_w; ++i) chunks[i].dirty = 1;
+	}
+	chunk_invalidate_rect(0, 0, map_w - 1, 0);
+	return GEN_ROOM;
+}
+
+/* ---------------- campaign (level list with background preloading) ---------------- */
+/* A campaign manifest lists map files, one per line; blank lines and lines starting
+ * with '#' are skipped and relative paths are taken from the manifest's directory.
+ * While a level is played the next one is parsed into its own Map on a worker thread,
+ * so finishing a level only swaps the grids in (map_install). A level that fails to
+ * load is reported and skipped. */
+#define CAMPAIGN_MAX_LEVELS 256
+#define CAMPAIGN_BANNER_TIME 2.5
+
+typedef struct {
+	char path[512];
+	size_t held; /* map memory resident while it loads (the current level) */
+	Map map;
+	int result;
+} LevelLoad;
+
+static char campaign_levels[CAMPAIGN_MAX_LEVELS][512];
+static int campaign_count = 0;
+static int campaign_cur = -1; /* level being played, -1 outside a campaign */
+static LevelLoad campaign_next;
+static int campaign_next_index = -1; /* level in campaign_next, -1 none */
+static SDL_Thread *campaign_thread = NULL;
+static SDL_atomic_t campaign_loaded;
+static double campaign_banner_until = 0.0;
+
+static int campaign_open(const char *manifest) {
+	FILE *f = fopen(manifest, "r");
+	if (!f) return -1;
+	const char *slash = strrchr(manifest, '/');
+	int dirlen = slash ? (int) (slash - manifest) + 1 : 0;
+	char line[512];
+	campaign_count = 0;
+	while (campaign_count < CAMPAIGN_MAX_LEVELS && fgets(line, sizeof(line), f)) {
+		char *p = line, *e = line + strlen(line);
+		while (*p == ' ' || *p == '\t') ++p;
+		while (e > p && (e[-1] == '\n' || e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) *--e = '\0';
+		if (*p == '\0' || *p == '#') continue;
+		if (*p == '/') snprintf(campaign_levels[campaign_count++], 512, "%s", p);
+		else
+			snprintf(campaign_levels[campaign_count++], 512, "%.*s%s", dirlen, manifest, p);
+	}
+	fclose(f);
+	return campaign_count ? 0 : -3;
+}
+
+static int campaign_load_main(void *data) {
+	LevelLoad *l = (LevelLoad *) data;
+	l->result = load_map_beside(l->path, l->held, &l->map);
+	SDL_AtomicSet(&campaign_loaded, 1);
+	return 0;
+}
+
+/* a loaded next level counts under MEM_MAP next to the current one until it is
+ * installed or dropped */
+static void campaign_hold(int hold) {
+	if (campaign_next.result != 0) return;
+	size_t bytes = campaign_next.map.mem.cap;
+	map_side_bytes = hold ? map_side_bytes + bytes : map_side_bytes - bytes;
+	mem_used[MEM_MAP] = hold ? mem_used[MEM_MAP] + bytes : mem_used[MEM_MAP] - bytes;
+}
+
+/* start parsing level i in the background; it has to fit the map budget next to
+ * everything already held */
+static void campaign_preload(int i) {
+	campaign_next_index = -1;
+	if (i >= campaign_count) return;
+	campaign_next_index = i;
+	snprintf(campaign_next.path, sizeof(campaign_next.path), "%s", campaign_levels[i]);
+	campaign_next.held = mem_used[MEM_MAP];
+	SDL_AtomicSet(&campaign_loaded, 0);
+	campaign_thread = SDL_CreateThread(campaign_load_main, "level-load", &campaign_next);
+	if (!campaign_thread) {
+		campaign_load_main(&campaign_next); /* no thread: load now */
+		campaign_hold(1);
+	}
+}
+
+/* join a finished preload; wait blocks for one in flight (closing only) */
+static int campaign_reap(int wait) {
+	if (campaign_next_index < 0) return 0;
+	if (campaign_thread) {
+		if (!wait && !SDL_AtomicGet(&campaign_loaded)) return 0;
+		SDL_WaitThread(campaign_thread, NULL);
+		campaign_thread = NULL;
+		campaign_hold(1);
+	}
+	return 1;
+}
+
+static void campaign_close(void) {
+	if (campaign_reap(1) && campaign_next.result == 0) {
+		campaign_hold(0);
+		map_free(&campaign_next.map);
+	}
+	campaign_next_index = -1;
+	campaign_cur = -1;
+}
+
+static int campaign_start(const char *manifest) {
+	campaign_close();
+	int res = campaign_open(manifest);
+	if (res != 0) return res;
+	if ((res = load_map_json_like(campaign_levels[0])) != 0) return res;
+	campaign_cur = 0;
+	campaign_banner_until = now_seconds() + CAMPAIGN_BANNER_TIME;
+	campaign_preload(1);
+	return 0;
+}
+
+/* after a level is finished: switch to the preloaded next level. Returns 1 when the
+ * map changed, 0 while it is still loading or when the campaign is over. */
+static int campaign_advance(void) {
+	if (campaign_cur < 0 || !campaign_reap(0)) return 0;
+	ALLOC_EXPECTED(); /* map_install and the next preload */
+	int idx = campaign_next_index;
+	if (campaign_next.result == -4) {
+		/* too big to sit next to the current level: load it now instead, as Load World
+		 * would, so it only has to fit the budget on its own */
+		campaign_next.result = load_map_file(campaign_next.path, &campaign_next.map);
+		campaign_hold(1);
+	}
+	if (campaign_next.result != 0) {
+		fprintf(stderr, "Campaign: failed to load %s (code %d), skipping\n", campaign_next.path, campaign_next.result);
+		campaign_cur = idx;
+		campaign_preload(idx + 1);
+		return 0;
+	}
+	campaign_hold(0);
+	map_install(&campaign_next.map);
+	snprintf(map_path, sizeof(map_path), "%s", campaign_next.path);
+	campaign_cur = idx;
+	campaign_banner_until = now_seconds() + CAMPAIGN_BANNER_TIME;
+	campaign_preload(idx + 1);
+	return 1;
+}
+
+/* R after the last level: play the campaign again from its first level */
+static int campaign_restart(void) {
+	Map m;
+	ALLOC_EXPECTED(); /* the level load and the next preload */
+	int res = load_map_file(campaign_levels[0], &m);
+	if (res != 0) {
+		fprintf(stderr, "Campaign: failed to load %s (code %d)\n", campaign_levels[0], res);
+		return res;
+	}
+	campaign_close();
+	map_install(&m);
+	snprintf(map_path, sizeof(map_path), "%s", campaign_levels[0]);
+	campaign_cur = 0;
+	campaign_banner_until = now_seconds() + CAMPAIGN_BANNER_TIME;
+	campaign_preload(1);
+	return 0;
+}
+
+/* switch play to m, a map that has already loaded (path "" if generated): the endless
+ * course and any campaign are only ended once their replacement is in hand, so a failed
+ * load leaves them running */
+static void play_map(Map *m, const char *path) {
+	stream_stop();
+	map_install(m);
+	snprintf(map_path, sizeof(map_path), "%s", path);
+	campaign_close();
+}
+
 /* ---------------- projection and drawing ---------------- */
 static int project_point(const Vec3 *p, const Camera *cam, int *sx, int *sy) {
 	double rx = p->x - cam->x, ry = p->y - cam->y, rz = p->z - cam->z;
@@ -345,23 +1543,298 @@ static void draw_wedge(SDL_Renderer *ren, const Camera *cam, int tx, int tz, int
 }
 
 /* draw map */
+/* Only chunks within VIEW_DISTANCE of the camera are visited, and a chunk is skipped when
+ * its bounding box lies entirely outside one plane of the view frustum: behind the near
+ * plane (an edge is only drawn when both ends are in front) or beyond one screen edge
+ * (every edge would be clipped away). rot holds sin/cos of -yaw and -pitch as used by
+ * project_point, and sx/sy its x and y scale. */
+#define VIEW_DISTANCE 128.0
+
+static int chunk_outside_view(const Camera *cam, const double rot[4], double sx, double sy, int cx, int cz) {
+	double x0 = cx * CHUNK_SIZE - cam->x, z0 = cz * CHUNK_SIZE - cam->z;
+	unsigned all = 31;
+	for (int i = 0; i < 8; ++i) {
+		double rx = i & 1 ? x0 + CHUNK_SIZE : x0, rz = i & 4 ? z0 + CHUNK_SIZE : z0;
+		double ry = (i & 2 ? 1.0 : 0.0) - cam->y;
+		double x1 = rx * rot[1] - rz * rot[0], z1 = rx * rot[0] + rz * rot[1];
+		double y1 = ry * rot[3] - z1 * rot[2], z2 = ry * rot[2] + z1 * rot[3];
+		unsigned out = (z2 <= 0.001) | (x1 * sx < -z2) << 1 | (x1 * sx > z2) << 2 | (y1 * sy < -z2) << 3 | (y1 * sy > z2) << 4;
+		all &= out;
+		if (!all) return 0;
+	}
+	return 1;
+}
+
 static void draw_map(SDL_Renderer *ren, const Camera *cam) {
-	for (int z = 0; z < map_h; ++z)
-		for (int x = 0; x < map_w; ++x) {
-			uint8_t t = map_cells[z * map_w + x];
-			if (t == TILE_EMPTY) continue;
-			uint8_t r = map_rots[z * map_w + x];
-			if (t == TILE_CUBE) draw_wire_cube(ren, cam, x + 0.5, 0.5, z + 0.5, 1.0, (SDL_Color) {0, 200, 0, 255});
-			else if (t == TILE_WEDGE)
-				draw_wedge(ren, cam, x, z, r, (SDL_Color) {220, 160, 40, 255});
-			else if (t == TILE_END)
-				draw_wire_cube(ren, cam, x + 0.5, 0.5, z + 0.5, 1.0, (SDL_Color) {200, 0, 0, 255});
+	double rot[4] = {sin(-cam->yaw), cos(-cam->yaw), sin(-cam->pitch), cos(-cam->pitch)};
+	double sy = 1.0 / tan(cam->fov * 0.5), sx = sy * WIN_W / WIN_H;
+	int cx0 = (int) floor((cam->x - VIEW_DISTANCE) / CHUNK_SIZE), cx1 = (int) floor((cam->x + VIEW_DISTANCE) / CHUNK_SIZE);
+	int cz0 = (int) floor((cam->z - VIEW_DISTANCE) / CHUNK_SIZE), cz1 = (int) floor((cam->z + VIEW_DISTANCE) / CHUNK_SIZE);
+	if (cx0 < 0) cx0 = 0;
+	if (cz0 < 0) cz0 = 0;
+	if (cx1 >= chunks_w) cx1 = chunks_w - 1;
+	if (cz1 >= chunks_h) cz1 = chunks_h - 1;
+	for (int cz = cz0; cz <= cz1; ++cz)
+		for (int cx = cx0; cx <= cx1; ++cx) {
+			/* distance from the camera to the nearest point of the chunk */
+			double dx = clampd(cam->x, cx * CHUNK_SIZE, (cx + 1) * CHUNK_SIZE) - cam->x;
+			double dz = clampd(cam->z, cz * CHUNK_SIZE, (cz + 1) * CHUNK_SIZE) - cam->z;
+			if (dx * dx + dz * dz > VIEW_DISTANCE * VIEW_DISTANCE) continue;
+			Chunk *c = &chunks[cz * chunks_w + cx];
+			if (c->dirty) chunk_rebuild(cx, cz);
+			if (!c->count || chunk_outside_view(cam, rot, sx, sy, cx, cz)) continue;
+			for (int i = 0; i < c->count; ++i) {
+				int x = (cx << CHUNK_SHIFT) + (c->idx[i] & (CHUNK_SIZE - 1));
+				int z = (cz << CHUNK_SHIFT) + (c->idx[i] >> CHUNK_SHIFT);
+				uint8_t t = map_cells[z * map_w + x];
+				uint8_t r = map_rots[z * map_w + x];
+				if (t == TILE_CUBE) draw_wire_cube(ren, cam, x + 0.5, 0.5, z + 0.5, 1.0, (SDL_Color) {0, 200, 0, 255});
+				else if (t == TILE_WEDGE)
+					draw_wedge(ren, cam, x, z, r, (SDL_Color) {220, 160, 40, 255});
+				else if (t == TILE_END)
+					draw_wire_cube(ren, cam, x + 0.5, 0.5, z + 0.5, 1.0, (SDL_Color) {200, 0, 0, 255});
+			}
 		}
 }
 
+/* ---------------- minimap ---------------- */
+/* Top-down view of the MINIMAP_VIEW cells around the player, one texel per cell, +z up.
+ * The texture covers an 8x8 block of chunks addressed modulo its size (chunk cx, cz
+ * lives in slot cx & 7, cz & 7, rows stored bottom-up), so moving only brings in the
+ * chunks that scroll into view. A slot is re-uploaded when the chunk it should hold
+ * has a different rebuild generation (edits, loads and streamed shifts all rebuild),
+ * at most MINIMAP_UPLOADS_PER_FRAME per frame. Drawing is up to four copies where the
+ * view wraps around the texture. */
+#define MINIMAP_SLOTS 8
+#define MINIMAP_TEX (MINIMAP_SLOTS * CHUNK_SIZE)
+#define MINIMAP_VIEW 96
+#define MINIMAP_SCALE 2
+#define MINIMAP_UPLOADS_PER_FRAME 16
+
+static int minimap_on = 1;
+static SDL_Texture *minimap_tex = NULL;
+static struct {
+	int cx, cz; /* chunk held by the slot */
+	uint32_t gen; /* its generation when uploaded, 0 for none */
+} minimap_slots[MINIMAP_SLOTS][MINIMAP_SLOTS];
+
+static uint32_t minimap_color(uint8_t t) {
+	switch (t) {
+	case TILE_EMPTY: return 0xdc14141eu;
+	case TILE_CUBE: return 0xdc00c800u;
+	case TILE_WEDGE: return 0xdcdca028u;
+	case TILE_END: return 0xdcc80000u;
+	default: return 0xdc8000c8u;
+	}
+}
+
+/* make slot (cx & 7, cz & 7) hold chunk (cx, cz); returns 1 if it uploaded */
+static int minimap_update_slot(int cx, int cz) {
+	int on_map = cx >= 0 && cz >= 0 && cx < chunks_w && cz < chunks_h;
+	uint32_t gen = 0xffffffffu; /* off the map; 0 marks a slot never uploaded */
+	if (on_map) {
+		Chunk *c = &chunks[cz * chunks_w + cx];
+		if (c->dirty) chunk_rebuild(cx, cz);
+		gen = c->gen;
+	}
+	int sx = cx & (MINIMAP_SLOTS - 1), sz = cz & (MINIMAP_SLOTS - 1);
+	if (minimap_slots[sz][sx].cx == cx && minimap_slots[sz][sx].cz == cz && minimap_slots[sz][sx].gen == gen) return 0;
+	uint32_t px[CHUNK_SIZE * CHUNK_SIZE];
+	for (int l = 0; l < CHUNK_SIZE; ++l) {
+		int z = cz * CHUNK_SIZE + l;
+		uint32_t *out = px + (CHUNK_SIZE - 1 - l) * CHUNK_SIZE; /* +z up */
+		for (int i = 0; i < CHUNK_SIZE; ++i) {
+			int x = cx * CHUNK_SIZE + i;
+			out[i] = on_map && x < map_w && z < map_h ? minimap_color(map_cells[(size_t) z * map_w + x]) : 0x80000000u;
+		}
+	}
+	SDL_Rect r = {sx * CHUNK_SIZE, MINIMAP_TEX - (sz + 1) * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE};
+	SDL_UpdateTexture(minimap_tex, &r, px, CHUNK_SIZE * (int) sizeof(uint32_t));
+	minimap_slots[sz][sx].cx = cx;
+	minimap_slots[sz][sx].cz = cz;
+	minimap_slots[sz][sx].gen = gen;
+	return 1;
+}
+
+static void draw_minimap(SDL_Renderer *ren, double px, double pz, double yaw) {
+	if (!minimap_tex) {
+		minimap_tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, MINIMAP_TEX, MINIMAP_TEX);
+		if (!minimap_tex) return;
+		SDL_SetTextureBlendMode(minimap_tex, SDL_BLENDMODE_BLEND);
+		memset(minimap_slots, 0, sizeof(minimap_slots));
+	}
+	int vx0 = (int) floor(px) - MINIMAP_VIEW / 2, vz0 = (int) floor(pz) - MINIMAP_VIEW / 2;
+	int vz1 = vz0 + MINIMAP_VIEW - 1;
+	/* the chunks under the view, nearest rows first so uploads favour the centre */
+	int cx0 = vx0 >> CHUNK_SHIFT, cx1 = (vx0 + MINIMAP_VIEW - 1) >> CHUNK_SHIFT;
+	int cz0 = vz0 >> CHUNK_SHIFT, cz1 = vz1 >> CHUNK_SHIFT, pcz = (int) floor(pz) >> CHUNK_SHIFT;
+	int uploads = 0;
+	for (int d = 0; d <= cz1 - cz0 && uploads < MINIMAP_UPLOADS_PER_FRAME; ++d)
+		for (int side = 0; side < 2 && uploads < MINIMAP_UPLOADS_PER_FRAME; ++side) {
+			int cz = side ? pcz + d : pcz - d;
+			if ((side && d == 0) || cz < cz0 || cz > cz1) continue;
+			for (int cx = cx0; cx <= cx1 && uploads < MINIMAP_UPLOADS_PER_FRAME; ++cx) uploads += minimap_update_slot(cx, cz);
+		}
+
+	/* texture rows run from high z at the top; split the view where it wraps */
+	int ox = WIN_W - MINIMAP_VIEW * MINIMAP_SCALE - 10, oy = 10;
+	int tx0 = vx0 & (MINIMAP_TEX - 1), ty0 = (MINIMAP_TEX - 1) - (vz1 & (MINIMAP_TEX - 1));
+	int wx = MINIMAP_TEX - tx0 < MINIMAP_VIEW ? MINIMAP_TEX - tx0 : MINIMAP_VIEW;
+	int wy = MINIMAP_TEX - ty0 < MINIMAP_VIEW ? MINIMAP_TEX - ty0 : MINIMAP_VIEW;
+	for (int py = 0; py < 2; ++py)
+		for (int pxi = 0; pxi < 2; ++pxi) {
+			int sw = pxi ? MINIMAP_VIEW - wx : wx, sh = py ? MINIMAP_VIEW - wy : wy;
+			if (sw <= 0 || sh <= 0) continue;
+			SDL_Rect src = {pxi ? 0 : tx0, py ? 0 : ty0, sw, sh};
+			SDL_Rect dst = {ox + (pxi ? wx : 0) * MINIMAP_SCALE, oy + (py ? wy : 0) * MINIMAP_SCALE, sw * MINIMAP_SCALE, sh * MINIMAP_SCALE};
+			SDL_RenderCopy(ren, minimap_tex, &src, &dst);
+		}
+	SDL_Rect frame = {ox - 1, oy - 1, MINIMAP_VIEW * MINIMAP_SCALE + 2, MINIMAP_VIEW * MINIMAP_SCALE + 2};
+	SDL_SetRenderDrawColor(ren, 0, 200, 0, 255);
+	SDL_RenderDrawRect(ren, &frame);
+
+	/* player and heading (movement forward is (sin yaw, cos yaw); +z is up) */
+	int mx = ox + (int) ((px - vx0) * MINIMAP_SCALE), my = oy + (int) ((vz1 + 1 - pz) * MINIMAP_SCALE);
+	SDL_Rect dot = {mx - 2, my - 2, 5, 5};
+	SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+	SDL_RenderFillRect(ren, &dot);
+	SDL_RenderDrawLine(ren, mx, my, mx + (int) (sin(yaw) * 10.0), my - (int) (cos(yaw) * 10.0));
+}
+
+static void minimap_free(void) {
+	if (minimap_tex) SDL_DestroyTexture(minimap_tex);
+	minimap_tex = NULL;
+}
+
 /* ---------------- text drawing ---------------- */
+/* Printable ASCII glyphs are rendered once, in white, into their own textures and tinted
+ * per draw with colour/alpha mod, so drawing text (changing HUD numbers included)
+ * creates no surfaces or textures per frame. Strings outside that range fall back to
+ * rendering the whole string. */
+#define GLYPH_FIRST 32
+#define GLYPH_LAST 126
+
+typedef struct {
+	SDL_Texture *tex;
+	int w, h, advance;
+} Glyph;
+
+static Glyph glyphs[GLYPH_LAST - GLYPH_FIRST + 1];
+static int glyphs_ready = 0;
+
+static void glyph_cache_init(SDL_Renderer *ren) {
+	glyphs_ready = 1;
+	for (int c = GLYPH_FIRST; c <= GLYPH_LAST; ++c) {
+		Glyph *g = &glyphs[c - GLYPH_FIRST];
+		int minx, maxx, miny, maxy;
+		if (TTF_GlyphMetrics(gfont, (Uint16) c, &minx, &maxx, &miny, &maxy, &g->advance) != 0) g->advance = 0;
+		if (c == ' ') continue;
+		SDL_Surface *surf = TTF_RenderGlyph_Blended(gfont, (Uint16) c, (SDL_Color) {255, 255, 255, 255});
+		if (!surf) continue;
+		g->tex = SDL_CreateTextureFromSurface(ren, surf);
+		g->w = surf->w;
+		g->h = surf->h;
+		if (g->tex) mem_used[MEM_TEXT] += (size_t) g->w * g->h * 4;
+		SDL_FreeSurface(surf);
+	}
+}
+
+/* Strings the glyphs can't draw are rendered whole and kept in a small LRU cache
+ * bounded by the text budget, so e.g. a non-ASCII path in the load box is not
+ * re-rendered every frame. */
+#define TEXT_CACHE_SLOTS 32
+
+typedef struct {
+	char *s;
+	SDL_Color col;
+	SDL_Texture *tex;
+	int w, h;
+	uint32_t last_used;
+} TextEntry;
+
+static TextEntry text_cache[TEXT_CACHE_SLOTS];
+static uint32_t text_clock = 0;
+
+static void text_entry_evict(TextEntry *e) {
+	mem_used[MEM_TEXT] -= (size_t) e->w * e->h * 4;
+	SDL_DestroyTexture(e->tex);
+	free(e->s);
+	memset(e, 0, sizeof(*e));
+}
+
+static TextEntry *text_cache_lru(void) {
+	TextEntry *lru = NULL;
+	for (int i = 0; i < TEXT_CACHE_SLOTS; ++i)
+		if (text_cache[i].tex && (!lru || text_cache[i].last_used < lru->last_used)) lru = &text_cache[i];
+	return lru;
+}
+
+static TextEntry *text_cache_get(SDL_Renderer *ren, const char *s, SDL_Color col) {
+	++text_clock;
+	TextEntry *slot = NULL;
+	for (int i = 0; i < TEXT_CACHE_SLOTS; ++i) {
+		TextEntry *e = &text_cache[i];
+		if (!e->tex) {
+			if (!slot) slot = e;
+		} else if (e->col.r == col.r && e->col.g == col.g && e->col.b == col.b && e->col.a == col.a && strcmp(e->s, s) == 0) {
+			e->last_used = text_clock;
+			return e;
+		}
+	}
+	SDL_Surface *surf = TTF_RenderUTF8_Blended(gfont, s, col);
+	if (!surf) return NULL;
+	size_t bytes = (size_t) surf->w * surf->h * 4;
+	TextEntry *lru;
+	while (mem_over(MEM_TEXT, bytes) && (lru = text_cache_lru()) != NULL) {
+		text_entry_evict(lru);
+		if (!slot) slot = lru;
+	}
+	if (!slot && (slot = text_cache_lru()) != NULL) text_entry_evict(slot);
+	TextEntry *e = NULL;
+	if (slot && !mem_over(MEM_TEXT, bytes)) {
+		slot->tex = SDL_CreateTextureFromSurface(ren, surf);
+		slot->s = slot->tex ? strdup(s) : NULL;
+		if (slot->s) {
+			slot->col = col;
+			slot->w = surf->w;
+			slot->h = surf->h;
+			slot->last_used = text_clock;
+			mem_used[MEM_TEXT] += bytes;
+			e = slot;
+		} else if (slot->tex) {
+			SDL_DestroyTexture(slot->tex);
+			slot->tex = NULL;
+		}
+	}
+	SDL_FreeSurface(surf);
+	return e; /* NULL: over budget even with the cache empty */
+}
+
 static void draw_text(SDL_Renderer *ren, const char *s, int x, int y, SDL_Color col) {
 	if (!gfont || !s) return;
+	if (!glyphs_ready) glyph_cache_init(ren);
+	const unsigned char *c = (const unsigned char *) s;
+	while (*c >= GLYPH_FIRST && *c <= GLYPH_LAST) ++c;
+	if (!*c) {
+		int pen = x;
+		for (c = (const unsigned char *) s; *c; ++c) {
+			Glyph *g = &glyphs[*c - GLYPH_FIRST];
+			if (g->tex) {
+				SDL_SetTextureColorMod(g->tex, col.r, col.g, col.b);
+				SDL_SetTextureAlphaMod(g->tex, col.a);
+				SDL_Rect dst = {pen, y, g->w, g->h};
+				SDL_RenderCopy(ren, g->tex, NULL, &dst);
+			}
+			pen += g->advance;
+		}
+		return;
+	}
+	TextEntry *e = text_cache_get(ren, s, col);
+	if (e) {
+		SDL_Rect dst = {x, y, e->w, e->h};
+		SDL_RenderCopy(ren, e->tex, NULL, &dst);
+		return;
+	}
 	SDL_Surface *surf = TTF_RenderUTF8_Blended(gfont, s, (SDL_Color) {col.r, col.g, col.b, col.a});
 	if (!surf) return;
 	SDL_Texture *tex = SDL_CreateTextureFromSurface(ren, surf);
@@ -373,17 +1846,323 @@ static void draw_text(SDL_Renderer *ren, const char *s, int x, int y, SDL_Color
 	}
 }
 
+static void text_cache_free(void) {
+	for (int i = 0; i <= GLYPH_LAST - GLYPH_FIRST; ++i)
+		if (glyphs[i].tex) SDL_DestroyTexture(glyphs[i].tex);
+	memset(glyphs, 0, sizeof(glyphs));
+	glyphs_ready = 0;
+	for (int i = 0; i < TEXT_CACHE_SLOTS; ++i)
+		if (text_cache[i].tex) text_entry_evict(&text_cache[i]);
+	mem_used[MEM_TEXT] = 0;
+}
+
+/* ---------------- map browser (async scan, thumbnails, disk cache) ---------------- */
+/* Load World lists the maps in a directory with a top-down thumbnail each. A session
+ * runs BROWSE_WORKERS threads: the first lists the directory and publishes the sorted
+ * entries, then all of them claim entries through an atomic counter and build the
+ * thumbnails. A thumbnail is one tile type per pixel, taken from the disk cache
+ * (~/.local/share/jumpi/thumbs, keyed by path and checked against the file's mtime and
+ * size) or else made with load_map_file and written back. The main thread only turns
+ * ready thumbnails of visible rows into textures, a few per frame. Closing the overlay
+ * cancels the session without waiting and moves it to a draining list; each frame
+ * frees the sessions whose threads have finished, without blocking. */
+#define BROWSE_WORKERS 2
+#define BROWSE_ROWS 7
+#define BROWSE_UPLOADS_PER_FRAME 4
+#define THUMB_SIZE 48
+#define THUMB_MAGIC 0x4d48544au /* "JTHM" */
+
+enum { THUMB_PENDING,
+	   THUMB_READY,
+	   THUMB_FAILED };
+
+typedef struct {
+	char path[512];
+	const char *name; /* points into path */
+	long long size, mtime;
+	int w, h, load_res; /* set with the thumbnail */
+	SDL_atomic_t state;
+	uint8_t thumb[THUMB_SIZE * THUMB_SIZE];
+	SDL_Texture *tex; /* main thread only */
+} BrowseEntry;
+
+typedef struct Browser {
+	char dir[512];
+	char thumb_dir[512]; /* cache directory, set by the scanning worker before go */
+	BrowseEntry *entries;
+	int count;
+	SDL_atomic_t started, scanned, next, cancel, running;
+	SDL_sem *go; /* posted once the listing is published */
+	SDL_Thread *threads[BROWSE_WORKERS];
+	struct Browser *drain_next; /* draining list link, main thread only */
+} Browser;
+
+typedef struct {
+	uint32_t magic;
+	int32_t w, h;
+	int32_t pad;
+	int64_t mtime, size;
+} ThumbHeader;
+
+static Browser *browser = NULL, *browser_draining = NULL;
+static int browser_sel = 0, browser_top = 0;
+
+static int browse_entry_cmp(const void *a, const void *b) { return strcmp(((const BrowseEntry *) a)->path, ((const BrowseEntry *) b)->path); }
+
+static void browse_scan(Browser *b) {
+	data_path("thumbs", b->thumb_dir, sizeof(b->thumb_dir));
+	mkdir(b->thumb_dir, 0755);
+	DIR *d = opendir(b->dir);
+	int cap = 0;
+	struct dirent *e;
+	while (d && !SDL_AtomicGet(&b->cancel) && (e = readdir(d)) != NULL) {
+		size_t n = strlen(e->d_name);
+		if (n < 6 || (strcmp(e->d_name + n - 5, ".json") != 0 && strcmp(e->d_name + n - 5, ".jmap") != 0)) continue;
+		if (b->count == cap) {
+			int ncap = cap ? cap * 2 : 64;
+			BrowseEntry *ne = (BrowseEntry *) realloc(b->entries, (size_t) ncap * sizeof(BrowseEntry));
+			if (!ne) break;
+			b->entries = ne;
+			cap = ncap;
+		}
+		BrowseEntry *be = &b->entries[b->count];
+		memset(be, 0, sizeof(*be));
+		snprintf(be->path, sizeof(be->path), "%s/%s", b->dir, e->d_name);
+		struct stat st;
+		if (stat(be->path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+		be->size = (long long) st.st_size;
+		be->mtime = (long long) st.st_mtime;
+		b->count++;
+	}
+	if (d) closedir(d);
+	if (b->count) qsort(b->entries, (size_t) b->count, sizeof(BrowseEntry), browse_entry_cmp);
+	for (int i = 0; i < b->count; ++i) b->entries[i].name = b->entries[i].path + strlen(b->dir) + 1;
+}
+
+static void thumb_cache_path(const Browser *b, const char *path, char *out, size_t n) {
+	char *resolved = realpath(path, NULL); /* any length; a fixed buffer would need PATH_MAX */
+	const char *key = resolved ? resolved : path;
+	uint64_t h = 1469598103934665603ull;
+	for (const char *p = key; *p; ++p) h = (h ^ (uint8_t) *p) * 1099511628211ull;
+	free(resolved);
+	snprintf(out, n, "%s/%016llx.thumb", b->thumb_dir, (unsigned long long) h);
+}
+
+static int thumb_cache_read(const char *cpath, BrowseEntry *e) {
+	int fd = open(cpath, O_RDONLY);
+	if (fd < 0) return -1;
+	ThumbHeader th;
+	int ok = read(fd, &th, sizeof(th)) == (ssize_t) sizeof(th) && th.magic == THUMB_MAGIC && th.mtime == e->mtime && th.size == e->size && read(fd, e->thumb, sizeof(e->thumb)) == (ssize_t) sizeof(e->thumb);
+	close(fd);
+	if (!ok) return -1;
+	e->w = th.w;
+	e->h = th.h;
+	return 0;
+}
+
+static void thumb_cache_write(const char *cpath, const BrowseEntry *e) {
+	char tmp[700];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cpath);
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return;
+	ThumbHeader th = {THUMB_MAGIC, e->w, e->h, 0, e->mtime, e->size};
+	int res = write_all(fd, &th, sizeof(th)) == 0 && write_all(fd, e->thumb, sizeof(e->thumb)) == 0 ? 0 : -1;
+	close(fd);
+	if (res != 0 || rename(tmp, cpath) != 0) unlink(tmp);
+}
+
+/* one pixel per block of cells, showing the most telling tile in the block (end over
+ * wedge over cube); the long side fills the thumbnail */
+static void thumb_from_map(BrowseEntry *e, const Map *m) {
+	int side = m->w > m->h ? m->w : m->h;
+	e->w = m->w;
+	e->h = m->h;
+	for (int ty = 0; ty < THUMB_SIZE; ++ty)
+		for (int tx = 0; tx < THUMB_SIZE; ++tx) {
+			int x0 = (int) ((long long) tx * side / THUMB_SIZE), x1 = (int) ((long long) (tx + 1) * side / THUMB_SIZE);
+			int z0 = (int) ((long long) ty * side / THUMB_SIZE), z1 = (int) ((long long) (ty + 1) * side / THUMB_SIZE);
+			if (x1 <= x0) x1 = x0 + 1;
+			if (z1 <= z0) z1 = z0 + 1;
+			uint8_t best = 0xff; /* outside the map */
+			if (x0 < m->w && z0 < m->h) {
+				best = TILE_EMPTY;
+				for (int z = z0; z < z1 && z < m->h && best != TILE_END; ++z)
+					for (int x = x0; x < x1 && x < m->w; ++x) {
+						uint8_t t = m->cells[(size_t) z * m->w + x];
+						if (t <= TILE_END && t > best) best = t; /* tile types are in that order */
+					}
+			}
+			e->thumb[ty * THUMB_SIZE + tx] = best;
+		}
+}
+
+static void browse_make_thumb(const Browser *b, BrowseEntry *e) {
+	char cpath[600];
+	thumb_cache_path(b, e->path, cpath, sizeof(cpath));
+	if (thumb_cache_read(cpath, e) == 0) {
+		SDL_AtomicSet(&e->state, THUMB_READY);
+		return;
+	}
+	Map m;
+	e->load_res = load_map_file(e->path, &m);
+	if (e->load_res != 0) {
+		SDL_AtomicSet(&e->state, THUMB_FAILED);
+		return;
+	}
+	thumb_from_map(e, &m);
+	map_free(&m);
+	thumb_cache_write(cpath, e);
+	SDL_AtomicSet(&e->state, THUMB_READY);
+}
+
+static int browse_worker_main(void *data) {
+	Browser *b = (Browser *) data;
+	if (SDL_AtomicAdd(&b->started, 1) == 0) {
+		browse_scan(b);
+		SDL_AtomicSet(&b->scanned, 1);
+		for (int t = 1; t < BROWSE_WORKERS; ++t) SDL_SemPost(b->go);
+	} else
+		SDL_SemWait(b->go);
+	int i;
+	while (!SDL_AtomicGet(&b->cancel) && (i = SDL_AtomicAdd(&b->next, 1)) < b->count) browse_make_thumb(b, &b->entries[i]);
+	SDL_AtomicAdd(&b->running, -1);
+	return 0;
+}
+
+static void browser_free(Browser *b) {
+	for (int t = 0; t < BROWSE_WORKERS; ++t)
+		if (b->threads[t]) SDL_WaitThread(b->threads[t], NULL);
+	for (int i = 0; i < b->count; ++i)
+		if (b->entries[i].tex) SDL_DestroyTexture(b->entries[i].tex);
+	free(b->entries);
+	if (b->go) SDL_DestroySemaphore(b->go);
+	free(b);
+}
+
+/* free cancelled sessions whose threads are done; wait blocks on all of them (exit only) */
+static void browser_poll(int wait) {
+	Browser **link = &browser_draining;
+	while (*link) {
+		Browser *b = *link;
+		if (wait || SDL_AtomicGet(&b->running) == 0) {
+			*link = b->drain_next;
+			browser_free(b);
+		} else
+			link = &b->drain_next;
+	}
+}
+
+static void browser_close(void) {
+	if (!browser) return;
+	SDL_AtomicSet(&browser->cancel, 1);
+	browser->drain_next = browser_draining;
+	browser_draining = browser;
+	browser = NULL;
+}
+
+static void browser_open(const char *dir) {
+	browser_close();
+	Browser *b = (Browser *) calloc(1, sizeof(Browser));
+	if (!b) return;
+	snprintf(b->dir, sizeof(b->dir), "%s", dir);
+	b->go = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&b->running, BROWSE_WORKERS);
+	for (int t = 0; t < BROWSE_WORKERS; ++t)
+		if (!(b->threads[t] = SDL_CreateThread(browse_worker_main, "map-browse", b))) {
+			/* without its thread this worker never runs: run it here, or the session
+			 * would never finish */
+			browse_worker_main(b);
+		}
+	browser = b;
+	browser_sel = browser_top = 0;
+}
+
+/* directory of the current map, or the working directory */
+static void browser_open_default(void) {
+	char dir[512];
+	const char *slash = strrchr(map_path, '/');
+	if (map_path[0] && slash) snprintf(dir, sizeof(dir), "%.*s", (int) (slash - map_path), map_path);
+	else
+		snprintf(dir, sizeof(dir), ".");
+	browser_open(dir);
+}
+
+static void browser_move(int d) {
+	if (!browser || !SDL_AtomicGet(&browser->scanned) || !browser->count) return;
+	browser_sel = (int) clampd(browser_sel + d, 0, browser->count - 1);
+	if (browser_sel < browser_top) browser_top = browser_sel;
+	if (browser_sel >= browser_top + BROWSE_ROWS) browser_top = browser_sel - BROWSE_ROWS + 1;
+}
+
+/* path of the selected map, NULL when there is none */
+static const char *browser_selected(void) {
+	if (!browser || !SDL_AtomicGet(&browser->scanned) || browser_sel >= browser->count) return NULL;
+	return browser->entries[browser_sel].path;
+}
+
+static SDL_Texture *thumb_texture(SDL_Renderer *ren, const BrowseEntry *e) {
+	uint32_t px[THUMB_SIZE * THUMB_SIZE];
+	for (int i = 0; i < THUMB_SIZE * THUMB_SIZE; ++i) {
+		uint8_t t = e->thumb[i];
+		px[i] = t == 0xff ? 0xff000000u : t == TILE_CUBE ? 0xff00c800u : t == TILE_WEDGE ? 0xffc8c800u : t == TILE_END ? 0xffff5050u : 0xff14141eu;
+	}
+	SDL_Texture *tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, THUMB_SIZE, THUMB_SIZE);
+	if (tex) SDL_UpdateTexture(tex, NULL, px, THUMB_SIZE * (int) sizeof(uint32_t));
+	return tex;
+}
+
+static void draw_browser(SDL_Renderer *ren, int x, int y) {
+	if (!browser) return;
+	if (!SDL_AtomicGet(&browser->scanned)) {
+		if (gfont) draw_text(ren, "Scanning...", x, y, (SDL_Color) {0, 200, 0, 255});
+		return;
+	}
+	if (!browser->count) {
+		if (gfont) draw_text(ren, "No maps in this directory", x, y, (SDL_Color) {0, 200, 0, 255});
+		return;
+	}
+	int uploads = 0;
+	for (int r = 0; r < BROWSE_ROWS && browser_top + r < browser->count; ++r) {
+		int i = browser_top + r;
+		BrowseEntry *e = &browser->entries[i];
+		int state = SDL_AtomicGet(&e->state);
+		SDL_Rect row = {x, y + r * 56, 640, 52};
+		SDL_SetRenderDrawColor(ren, 0, 0, 0, 120);
+		SDL_RenderFillRect(ren, &row);
+		if (i == browser_sel) SDL_SetRenderDrawColor(ren, 0, 255, 0, 255);
+		else
+			SDL_SetRenderDrawColor(ren, 0, 120, 0, 200);
+		SDL_RenderDrawRect(ren, &row);
+		SDL_Rect th = {x + 2, y + r * 56 + 2, THUMB_SIZE, THUMB_SIZE};
+		if (state == THUMB_READY && !e->tex && uploads < BROWSE_UPLOADS_PER_FRAME) {
+			e->tex = thumb_texture(ren, e);
+			uploads++;
+		}
+		if (e->tex) SDL_RenderCopy(ren, e->tex, NULL, &th);
+		if (gfont) {
+			char line[160];
+			draw_text(ren, e->name, x + THUMB_SIZE + 12, y + r * 56 + 4, (SDL_Color) {180, 255, 180, 255});
+			if (state == THUMB_READY) snprintf(line, sizeof(line), "%d x %d  %.1f KiB", e->w, e->h, e->size / 1024.0);
+			else if (state == THUMB_FAILED)
+				snprintf(line, sizeof(line), "cannot load (code %d)", e->load_res);
+			else
+				snprintf(line, sizeof(line), "%.1f KiB  ...", e->size / 1024.0);
+			draw_text(ren, line, x + THUMB_SIZE + 12, y + r * 56 + 26, state == THUMB_FAILED ? (SDL_Color) {255, 80, 80, 255} : (SDL_Color) {0, 180, 0, 255});
+		}
+	}
+}
+
 /* ---------------- UI drawing ---------------- */
 static void draw_main_menu(SDL_Renderer *ren) {
-	int cx = WIN_W / 2 - 220, cy = WIN_H / 2 - 180;
+	int cx = WIN_W / 2 - 220, cy = WIN_H / 2 - 244;
 	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
-	SDL_Rect panel = {cx - 24, cy - 24, 480, 360};
+	SDL_Rect panel = {cx - 24, cy - 24, 480, 488};
 	SDL_SetRenderDrawColor(ren, 0, 0, 0, 180);
 	SDL_RenderFillRect(ren, &panel);
 	SDL_SetRenderDrawColor(ren, 0, 200, 0, 220);
 	SDL_RenderDrawRect(ren, &panel);
-	const char *items[] = {"Resume", "Load World", "Settings", "Credits", "Quit"};
-	int nitems = 5;
+	const char *items[] = {"Resume", "Load World", "Generate Course", "Endless Run", "Settings", "Credits", "Quit"};
+	int nitems = 7;
 	for (int i = 0; i < nitems; ++i) {
 		SDL_Rect r = {cx, cy + i * 64, 420, 48};
 		SDL_SetRenderDrawColor(ren, 0, 0, 0, 120);
@@ -407,9 +2186,9 @@ static void draw_main_menu(SDL_Renderer *ren) {
 }
 
 static void draw_load_overlay(SDL_Renderer *ren) {
-	int cx = WIN_W / 2 - 320, cy = WIN_H / 2 - 80;
+	int cx = WIN_W / 2 - 320, cy = WIN_H / 2 - 240;
 	SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
-	SDL_Rect outer = {cx - 12, cy - 12, 664, 164};
+	SDL_Rect outer = {cx - 12, cy - 12, 664, 96 + BROWSE_ROWS * 56};
 	SDL_SetRenderDrawColor(ren, 0, 0, 0, 200);
 	SDL_RenderFillRect(ren, &outer);
 	SDL_SetRenderDrawColor(ren, 0, 200, 0, 255);
@@ -420,10 +2199,11 @@ static void draw_load_overlay(SDL_Renderer *ren) {
 	SDL_SetRenderDrawColor(ren, 0, 200, 0, 255);
 	SDL_RenderDrawRect(ren, &box);
 	if (gfont) {
-		draw_text(ren, "Type path and press Enter to load (Esc to cancel):", cx, cy - 28, (SDL_Color) {0, 200, 0, 255});
+		draw_text(ren, "Pick a map (Up/Down) or type a path, Enter to load:", cx, cy - 28, (SDL_Color) {0, 200, 0, 255});
 		draw_text(ren, load_path, cx + 8, cy + 8, (SDL_Color) {0, 255, 0, 255});
-		if (load_err[0]) draw_text(ren, load_err, cx, cy + 56, (SDL_Color) {255, 80, 80, 255});
+		if (load_err[0]) draw_text(ren, load_err, cx, cy + 48, (SDL_Color) {255, 80, 80, 255});
 	}
+	draw_browser(ren, cx, cy + 76);
 }
 
 static void draw_settings_overlay(SDL_Renderer *ren) {
@@ -443,6 +2223,13 @@ static void draw_settings_overlay(SDL_Renderer *ren) {
 		draw_text(ren, buf, cx + 12, cy + 80, (SDL_Color) {0, 200, 0, 255});
 		snprintf(buf, sizeof(buf), "Invert Mouse X: %s (press X)", invert_mouse_x ? "On" : "Off");
 		draw_text(ren, buf, cx + 12, cy + 112, (SDL_Color) {0, 200, 0, 255});
+		draw_text(ren, "Memory:", cx + 12, cy + 152, (SDL_Color) {0, 200, 0, 255});
+		for (int i = 0; i < MEM_SYS_COUNT; ++i) {
+			if (mem_budget[i]) snprintf(buf, sizeof(buf), "  %-7s %9.1f KiB of %.0f KiB", mem_sys_names[i], mem_used[i] / 1024.0, mem_budget[i] / 1024.0);
+			else
+				snprintf(buf, sizeof(buf), "  %-7s %9.1f KiB (no budget)", mem_sys_names[i], mem_used[i] / 1024.0);
+			draw_text(ren, buf, cx + 12, cy + 176 + i * 24, mem_over(i, 0) ? (SDL_Color) {255, 80, 80, 255} : (SDL_Color) {0, 180, 0, 255});
+		}
 	}
 }
 
@@ -604,29 +2391,1106 @@ static void physics_step(Player *p, const Input *in, double dt, int *level_compl
 	resolve_collisions(p, level_complete);
 }
 
-/* ---------------- main ---------------- */
-int main(int argc, char **argv) {
-	const char *mapfile = NULL;
-	if (argc >= 2) mapfile = argv[1];
+/* back to the spawn point at rest, as at the start of a level */
+static void player_respawn(Player *p) {
+	p->px = 3.5;
+	p->pz = 3.5;
+	p->py = 2.0;
+	p->vx = p->vy = p->vz = 0.0;
+	p->grounded = 0;
+	p->time_since_grounded = 0.0;
+}
+
+/* ---------------- editor ---------------- */
+/* Tab toggles edit mode. The crosshair ray is walked cell by cell (DDA in x/z) to find
+ * the first solid tile it passes through at tile height, and the last empty cell
+ * before it (or the floor cell it lands on) as the place target. Every edit goes
+ * through map_set_cell, which invalidates only the chunk the cell belongs to. */
+#define EDITOR_REACH 48.0
+
+typedef struct {
+	int has_hit, hit_x, hit_z;       /* solid tile under the crosshair */
+	int has_place, place_x, place_z; /* empty cell a new tile would go into */
+} EditTarget;
+
+static int editor_on = 0;
+static int editor_tile = TILE_CUBE;
+static int editor_rot = 0;
+
+/* write len consecutive cells (rows wrap) starting at linear index start, journaling
+ * the old values when an operation is open, and invalidate the touched chunks */
+static void map_fill_run(size_t start, size_t len, uint8_t type, uint8_t rot) {
+	if (!len) return;
+	if (journal_open) {
+		size_t i = start, end = start + len;
+		while (i < end) {
+			uint8_t ot = map_cells[i], orr = map_rots[i];
+			size_t j = i + 1;
+			while (j < end && map_cells[j] == ot && map_rots[j] == orr) ++j;
+			if (ot != type || orr != rot) journal_note((uint32_t) i, (uint32_t) (j - i), ot, orr, type, rot);
+			i = j;
+		}
+	}
+	memset(map_cells + start, type, len);
+	memset(map_rots + start, rot, len);
+	++map_edit_serial;
+	int z0 = (int) (start / map_w), z1 = (int) ((start + len - 1) / map_w);
+	if (z0 == z1) chunk_invalidate_rect((int) (start % map_w), z0, (int) ((start + len - 1) % map_w), z1);
+	else
+		chunk_invalidate_rect(0, z0, map_w - 1, z1);
+}
+
+static void map_set_cell(int x, int z, uint8_t type, uint8_t rot) {
+	if (!in_map(x, z)) return;
+	size_t i = (size_t) z * map_w + x;
+	if (map_cells[i] == type && map_rots[i] == rot) return;
+	map_fill_run(i, 1, type, rot);
+}
+
+static int editor_undo(void) {
+	if (!journal_cursor) return 0;
+	size_t op = --journal_cursor;
+	size_t first = journal_ops[op], end = op + 1 < journal_nops ? journal_ops[op + 1] : journal_nruns;
+	for (size_t r = end; r-- > first;) map_fill_run(journal_runs[r].start, journal_runs[r].len, journal_runs[r].old_type, journal_runs[r].old_rot);
+	return 1;
+}
+
+static int editor_redo(void) {
+	if (journal_cursor >= journal_nops) return 0;
+	size_t op = journal_cursor++;
+	size_t first = journal_ops[op], end = op + 1 < journal_nops ? journal_ops[op + 1] : journal_nruns;
+	for (size_t r = first; r < end; ++r) map_fill_run(journal_runs[r].start, journal_runs[r].len, journal_runs[r].new_type, journal_runs[r].new_rot);
+	return 1;
+}
+
+/* direction through the screen centre; the inverse of project_point's rotation */
+static Vec3 camera_forward(const Camera *cam) {
+	Vec3 d = {-sin(cam->yaw) * cos(cam->pitch), -sin(cam->pitch), cos(cam->yaw) * cos(cam->pitch)};
+	return d;
+}
+
+static void editor_pick(const Camera *cam, EditTarget *t) {
+	memset(t, 0, sizeof(*t));
+	Vec3 d = camera_forward(cam);
+	int x = (int) floor(cam->x), z = (int) floor(cam->z);
+	int step_x = d.x > 0 ? 1 : -1, step_z = d.z > 0 ? 1 : -1;
+	double dt_x = fabs(d.x) > 1e-9 ? fabs(1.0 / d.x) : 1e30;
+	double dt_z = fabs(d.z) > 1e-9 ? fabs(1.0 / d.z) : 1e30;
+	double next_x = fabs(d.x) > 1e-9 ? ((d.x > 0 ? x + 1 : x) - cam->x) / d.x : 1e30;
+	double next_z = fabs(d.z) > 1e-9 ? ((d.z > 0 ? z + 1 : z) - cam->z) / d.z : 1e30;
+	double t0 = 0.0;
+	while (t0 < EDITOR_REACH && in_map(x, z)) {
+		double t1 = next_x < next_z ? next_x : next_z;
+		double y0 = cam->y + d.y * t0, y1 = cam->y + d.y * t1;
+		double ylo = y0 < y1 ? y0 : y1, yhi = y0 < y1 ? y1 : y0;
+		if (map_cells[z * map_w + x] != TILE_EMPTY) {
+			if (ylo <= 1.0 && yhi >= 0.0) {
+				t->has_hit = 1;
+				t->hit_x = x;
+				t->hit_z = z;
+				return;
+			}
+		} else {
+			if (yhi >= 0.0) {
+				t->has_place = 1;
+				t->place_x = x;
+				t->place_z = z;
+			}
+			if (ylo <= 0.0) return; /* reached the floor in this cell */
+		}
+		if (next_x < next_z) {
+			x += step_x;
+			next_x += dt_x;
+		} else {
+			z += step_z;
+			next_z += dt_z;
+		}
+		t0 = t1;
+	}
+	t->has_place = 0; /* ran off the map or out of reach */
+}
+
+/* Bulk edits (box fill, flood fill, paste) run as a job that writes whole row spans
+ * through map_fill_run and is time-sliced across frames, so multi-million-cell edits
+ * never stall a frame; the HUD shows progress. The whole job is one undo operation. */
+#define EDIT_JOB_SLICE 0.004 /* seconds of work per frame */
+
+enum { JOB_NONE,
+	   JOB_BOX,
+	   JOB_FLOOD,
+	   JOB_PASTE };
+
+typedef struct {
+	int kind;
+	const uint8_t *grid;     /* map_cells at start; the job stops if the map is replaced */
+	int x0, z0, x1, z1, row; /* box/paste rect (inclusive) and next row */
+	uint8_t type, rot;       /* box/flood: value written */
+	uint8_t match_type, match_rot; /* flood: value of the region */
+	int *stack;              /* flood: seed (x, z) pairs */
+	size_t nstack, stack_cap;
+	size_t done, total; /* cells visited; total 0 when unknown (flood) */
+} EditJob;
+
+static EditJob edit_job;
+static Map clipboard;
+
+/* wedge rotation after turning the grid 90 degrees clockwise: +x->+z, +z->-x, -x->-z, -z->+x */
+static const uint8_t rot_cw[4] = {2, 3, 1, 0};
+
+static int edit_job_push(int x, int z) {
+	if (edit_job.nstack + 2 > edit_job.stack_cap) {
+		size_t cap = edit_job.stack_cap ? edit_job.stack_cap * 2 : 4096;
+		int *st = (int *) realloc(edit_job.stack, cap * sizeof(int));
+		if (!st) return 0;
+		edit_job.stack = st;
+		edit_job.stack_cap = cap;
+	}
+	edit_job.stack[edit_job.nstack++] = x;
+	edit_job.stack[edit_job.nstack++] = z;
+	return 1;
+}
+
+static void edit_job_finish(void) {
+	journal_end();
+	free(edit_job.stack);
+	memset(&edit_job, 0, sizeof(edit_job));
+}
+
+static int edit_job_start(int kind, int x0, int z0, int x1, int z1) {
+	if (edit_job.kind != JOB_NONE) return 0;
+	memset(&edit_job, 0, sizeof(edit_job));
+	edit_job.kind = kind;
+	edit_job.grid = map_cells;
+	edit_job.x0 = x0 < x1 ? x0 : x1;
+	edit_job.x1 = x0 < x1 ? x1 : x0;
+	edit_job.z0 = z0 < z1 ? z0 : z1;
+	edit_job.z1 = z0 < z1 ? z1 : z0;
+	edit_job.row = edit_job.z0;
+	edit_job.total = (size_t) (edit_job.x1 - edit_job.x0 + 1) * (edit_job.z1 - edit_job.z0 + 1);
+	journal_begin();
+	return 1;
+}
+
+static int flood_match(size_t i) { return map_cells[i] == edit_job.match_type && map_rots[i] == edit_job.match_rot; }
+
+/* one scanline flood step: fill the whole matching span through the seed and queue
+ * one seed per matching span in the rows above and below */
+static void flood_span(int x, int z) {
+	size_t row = (size_t) z * map_w;
+	if (!flood_match(row + x)) return;
+	int l = x, r = x;
+	while (l > 0 && flood_match(row + l - 1)) --l;
+	while (r < map_w - 1 && flood_match(row + r + 1)) ++r;
+	map_fill_run(row + l, (size_t) (r - l + 1), edit_job.type, edit_job.rot);
+	edit_job.done += (size_t) (r - l + 1);
+	for (int nz = z - 1; nz <= z + 1; nz += 2) {
+		if (nz < 0 || nz >= map_h) continue;
+		size_t nrow = (size_t) nz * map_w;
+		int in_span = 0;
+		for (int i = l; i <= r; ++i) {
+			if (flood_match(nrow + i)) {
+				if (!in_span && !edit_job_push(i, nz)) return;
+				in_span = 1;
+			} else
+				in_span = 0;
+		}
+	}
+}
+
+/* write one clipboard row at (x0, z), clipped to the map, as runs of equal value */
+static void paste_row(int x0, int z, int crow) {
+	const uint8_t *ct = clipboard.cells + (size_t) crow * clipboard.w, *cr = clipboard.rots + (size_t) crow * clipboard.w;
+	int n = clipboard.w;
+	if (x0 + n > map_w) n = map_w - x0;
+	for (int i = 0; i < n;) {
+		int j = i + 1;
+		while (j < n && ct[j] == ct[i] && cr[j] == cr[i]) ++j;
+		map_fill_run((size_t) z * map_w + x0 + i, (size_t) (j - i), ct[i], cr[i]);
+		i = j;
+	}
+	edit_job.done += (size_t) n;
+}
+
+/* advance the running job until the deadline */
+static void edit_job_step(double deadline) {
+	if (edit_job.kind == JOB_NONE) return;
+	if (edit_job.grid != map_cells) {
+		edit_job_finish(); /* map replaced underneath us */
+		return;
+	}
+	int n = 0;
+	if (edit_job.kind == JOB_FLOOD) {
+		while (edit_job.nstack) {
+			int z = edit_job.stack[--edit_job.nstack];
+			int x = edit_job.stack[--edit_job.nstack];
+			flood_span(x, z);
+			if ((++n & 63) == 0 && now_seconds() > deadline) return;
+		}
+	} else {
+		while (edit_job.row <= edit_job.z1) {
+			int z = edit_job.row++;
+			if (edit_job.kind == JOB_BOX) {
+				map_fill_run((size_t) z * map_w + edit_job.x0, (size_t) (edit_job.x1 - edit_job.x0 + 1), edit_job.type, edit_job.rot);
+				edit_job.done += (size_t) (edit_job.x1 - edit_job.x0 + 1);
+			} else
+				paste_row(edit_job.x0, z, z - edit_job.z0);
+			if ((++n & 7) == 0 && now_seconds() > deadline) return;
+		}
+	}
+	edit_job_finish();
+}
+
+/* the selected rectangle, ordered and clipped to the map; 0 when there is none */
+static int sel_rect(int *x0, int *z0, int *x1, int *z1) {
+	if (sel_state != 2) return 0;
+	*x0 = sel_x0 < sel_x1 ? sel_x0 : sel_x1;
+	*x1 = sel_x0 < sel_x1 ? sel_x1 : sel_x0;
+	*z0 = sel_z0 < sel_z1 ? sel_z0 : sel_z1;
+	*z1 = sel_z0 < sel_z1 ? sel_z1 : sel_z0;
+	if (*x0 < 0) *x0 = 0;
+	if (*z0 < 0) *z0 = 0;
+	if (*x1 >= map_w) *x1 = map_w - 1;
+	if (*z1 >= map_h) *z1 = map_h - 1;
+	return *x0 <= *x1 && *z0 <= *z1;
+}
+
+static void edit_box(uint8_t type, uint8_t rot) {
+	int x0, z0, x1, z1;
+	if (!sel_rect(&x0, &z0, &x1, &z1) || !edit_job_start(JOB_BOX, x0, z0, x1, z1)) return;
+	edit_job.type = type;
+	edit_job.rot = rot;
+}
+
+static void edit_flood(int x, int z, uint8_t type, uint8_t rot) {
+	size_t i = (size_t) z * map_w + x;
+	if (!in_map(x, z) || (map_cells[i] == type && map_rots[i] == rot)) return;
+	if (!edit_job_start(JOB_FLOOD, x, z, x, z)) return;
+	edit_job.type = type;
+	edit_job.rot = rot;
+	edit_job.match_type = map_cells[i];
+	edit_job.match_rot = map_rots[i];
+	edit_job.total = 0;
+	edit_job_push(x, z);
+}
+
+static void edit_copy(void) {
+	int x0, z0, x1, z1;
+	if (!sel_rect(&x0, &z0, &x1, &z1)) return;
+	Map c;
+	if (map_alloc(&c, x1 - x0 + 1, z1 - z0 + 1) != 0) return;
+	for (int z = z0; z <= z1; ++z) {
+		memcpy(c.cells + (size_t) (z - z0) * c.w, map_cells + (size_t) z * map_w + x0, (size_t) c.w);
+		memcpy(c.rots + (size_t) (z - z0) * c.w, map_rots + (size_t) z * map_w + x0, (size_t) c.w);
+	}
+	map_free(&clipboard);
+	clipboard = c;
+}
+
+/* turn the clipboard 90 degrees clockwise: (x, z) -> (h - 1 - z, x) */
+static void edit_rotate_clipboard(void) {
+	if (!clipboard.cells) return;
+	Map r;
+	if (map_alloc(&r, clipboard.h, clipboard.w) != 0) return;
+	for (int z = 0; z < clipboard.h; ++z)
+		for (int x = 0; x < clipboard.w; ++x) {
+			size_t src = (size_t) z * clipboard.w + x, dst = (size_t) x * r.w + (clipboard.h - 1 - z);
+			r.cells[dst] = clipboard.cells[src];
+			r.rots[dst] = clipboard.cells[src] == TILE_WEDGE ? rot_cw[clipboard.rots[src] & 3] : clipboard.rots[src];
+		}
+	map_free(&clipboard);
+	clipboard = r;
+}
+
+static void edit_paste(int x, int z) {
+	if (!clipboard.cells || !in_map(x, z)) return;
+	int z1 = z + clipboard.h - 1 < map_h ? z + clipboard.h - 1 : map_h - 1;
+	int x1 = x + clipboard.w - 1 < map_w ? x + clipboard.w - 1 : map_w - 1;
+	edit_job_start(JOB_PASTE, x, z, x1, z1);
+}
+
+/* Ctrl+S writes the map back to its file (or untitled.json in the data directory);
+ * autosave writes "<name>.autosave<ext>" next to it every AUTOSAVE_INTERVAL seconds while
+ * there are unsaved edits, leaving the real file alone until the user saves. */
+#define AUTOSAVE_INTERVAL 30.0
+
+static char save_status[160] = {0};
+static double save_status_time = 0.0;
+static int save_is_auto = 0;
+static unsigned save_serial = 0;
+
+/* 0, or -1 when the path does not fit in n bytes */
+static int autosave_path(char *out, size_t n) {
+	if (!map_path[0]) return strlen(data_path("autosave.json", out, n)) + 1 < n ? 0 : -1;
+	const char *dot = strrchr(map_path, '.'), *slash = strrchr(map_path, '/');
+	if (!dot || (slash && dot < slash)) dot = map_path + strlen(map_path);
+	return (size_t) snprintf(out, n, "%.*s.autosave%s", (int) (dot - map_path), map_path, dot) < n ? 0 : -1;
+}
+
+/* the file name part of path, for status lines */
+static const char *save_name(const char *path) {
+	const char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+static void editor_save(int is_auto) {
+	char path[sizeof(map_path)];
+	int fits = 1;
+	if (is_auto) fits = autosave_path(path, sizeof(path)) == 0;
+	else if (map_path[0])
+		snprintf(path, sizeof(path), "%s", map_path);
+	else
+		fits = strlen(data_path("untitled.json", path, sizeof(path))) + 1 < sizeof(path);
+	if (!fits) {
+		/* never write to a truncated path; wait an interval before the next autosave */
+		autosave_last = now_seconds();
+		snprintf(save_status, sizeof(save_status), "Save FAILED (path too long)");
+		save_status_time = now_seconds();
+		return;
+	}
+	if (!map_path[0]) snprintf(map_path, sizeof(map_path), "%s", path);
+	int res = map_save_async(path);
+	if (res == 0) {
+		save_is_auto = is_auto;
+		save_serial = map_edit_serial;
+		autosave_last = now_seconds();
+		if (!is_auto) snprintf(save_status, sizeof(save_status), "Saving %.120s...", save_name(path));
+	} else if (!is_auto)
+		snprintf(save_status, sizeof(save_status), res == -1 ? "A save is already running" : "Not enough memory to save");
+	if (!is_auto) save_status_time = now_seconds();
+}
+
+/* per frame: reap a finished save and start an autosave when one is due */
+static void editor_save_tick(double now) {
+	int result;
+	char path[sizeof(map_path)];
+	if (map_save_poll(0, &result, path, sizeof(path))) {
+		if (result == 0) {
+			map_autosaved_serial = save_serial;
+			if (!save_is_auto) map_saved_serial = save_serial;
+		}
+		if (!save_is_auto || result != 0) {
+			snprintf(save_status, sizeof(save_status), result == 0 ? "Saved %.120s" : "Save FAILED (%.120s)", save_name(path));
+			save_status_time = now;
+		}
+	}
+	if (map_edit_serial != map_autosaved_serial && map_edit_serial != map_saved_serial && edit_job.kind == JOB_NONE && now - autosave_last >= AUTOSAVE_INTERVAL) editor_save(1);
+}
+
+static void editor_key(const Camera *cam, int sym) {
+	int ctrl = (SDL_GetModState() & KMOD_CTRL) != 0, shift = (SDL_GetModState() & KMOD_SHIFT) != 0;
+	if (ctrl && (sym == SDLK_y || (sym == SDLK_z && shift))) {
+		if (edit_job.kind == JOB_NONE) editor_redo();
+	} else if (ctrl && sym == SDLK_z) {
+		if (edit_job.kind == JOB_NONE) editor_undo();
+	} else if (ctrl && sym == SDLK_s) {
+		if (edit_job.kind == JOB_NONE) editor_save(0);
+		return;
+	} else if (sym == SDLK_1)
+		editor_tile = TILE_CUBE;
+	else if (sym == SDLK_2)
+		editor_tile = TILE_WEDGE;
+	else if (sym == SDLK_3)
+		editor_tile = TILE_END;
+	else if (sym == SDLK_q)
+		editor_rot = (editor_rot + 1) & 3;
+	if (edit_job.kind != JOB_NONE) return; /* the map is mid-edit */
+	EditTarget t;
+	editor_pick(cam, &t);
+	int has_cell = t.has_hit || t.has_place;
+	int cx = t.has_hit ? t.hit_x : t.place_x, cz = t.has_hit ? t.hit_z : t.place_z;
+	uint8_t rot = editor_tile == TILE_WEDGE ? (uint8_t) editor_rot : 0;
+	if (sym == SDLK_v && has_cell) {
+		if (sel_state == 1) {
+			sel_x1 = cx;
+			sel_z1 = cz;
+			sel_state = 2;
+		} else {
+			sel_x0 = sel_x1 = cx;
+			sel_z0 = sel_z1 = cz;
+			sel_state = 1;
+		}
+	} else if (sym == SDLK_f)
+		edit_box((uint8_t) editor_tile, rot);
+	else if (sym == SDLK_DELETE || sym == SDLK_BACKSPACE)
+		edit_box(TILE_EMPTY, 0);
+	else if (sym == SDLK_g && has_cell)
+		edit_flood(cx, cz, (uint8_t) editor_tile, rot);
+	else if (sym == SDLK_c)
+		edit_copy();
+	else if (sym == SDLK_t)
+		edit_rotate_clipboard();
+	else if (sym == SDLK_p && has_cell)
+		edit_paste(cx, cz);
+}
+
+static void editor_click(const Camera *cam, int button) {
+	EditTarget t;
+	if (edit_job.kind != JOB_NONE) return;
+	editor_pick(cam, &t);
+	journal_begin();
+	if (button == SDL_BUTTON_LEFT && t.has_place) map_set_cell(t.place_x, t.place_z, (uint8_t) editor_tile, editor_tile == TILE_WEDGE ? (uint8_t) editor_rot : 0);
+	else if (button == SDL_BUTTON_RIGHT && t.has_hit)
+		map_set_cell(t.hit_x, t.hit_z, TILE_EMPTY, 0);
+	journal_end();
+}
+
+static void draw_floor_rect(SDL_Renderer *ren, const Camera *cam, int x0, int z0, int x1, int z1) {
+	Vec3 c[4] = {{x0, 0.02, z0}, {x1 + 1, 0.02, z0}, {x1 + 1, 0.02, z1 + 1}, {x0, 0.02, z1 + 1}};
+	int px[4], py[4], vis[4];
+	for (int i = 0; i < 4; ++i) vis[i] = project_point(&c[i], cam, &px[i], &py[i]);
+	for (int i = 0; i < 4; ++i)
+		if (vis[i] && vis[(i + 1) & 3]) SDL_RenderDrawLine(ren, px[i], py[i], px[(i + 1) & 3], py[(i + 1) & 3]);
+}
+
+static void draw_editor(SDL_Renderer *ren, const Camera *cam) {
+	EditTarget t;
+	editor_pick(cam, &t);
+	if (sel_state) {
+		SDL_SetRenderDrawColor(ren, 80, 200, 255, 255);
+		draw_floor_rect(ren, cam, sel_x0 < sel_x1 ? sel_x0 : sel_x1, sel_z0 < sel_z1 ? sel_z0 : sel_z1, sel_x0 < sel_x1 ? sel_x1 : sel_x0, sel_z0 < sel_z1 ? sel_z1 : sel_z0);
+	}
+	if (t.has_hit) draw_wire_cube(ren, cam, t.hit_x + 0.5, 0.5, t.hit_z + 0.5, 1.04, (SDL_Color) {255, 80, 80, 255});
+	if (t.has_place) {
+		if (editor_tile == TILE_WEDGE) draw_wedge(ren, cam, t.place_x, t.place_z, editor_rot, (SDL_Color) {255, 255, 120, 255});
+		else
+			draw_wire_cube(ren, cam, t.place_x + 0.5, 0.5, t.place_z + 0.5, 1.0, (SDL_Color) {255, 255, 120, 255});
+	}
+	if (gfont) {
+		static const char *names[] = {"Empty", "Cube", "Wedge", "End"};
+		char buf[160];
+		snprintf(buf, sizeof(buf), "EDITOR  tile: %s rot %d  (1/2/3 tile, Q rotate, LMB place, RMB remove, Tab exit)", names[editor_tile], editor_rot);
+		draw_text(ren, buf, 10, WIN_H - 28, (SDL_Color) {255, 255, 120, 255});
+		snprintf(buf, sizeof(buf), "undo %d  redo %d  (Ctrl+Z / Ctrl+Y)  Ctrl+S save   V select  F fill  Del clear  G flood  C copy  T turn  P paste", (int) journal_cursor, (int) (journal_nops - journal_cursor));
+		draw_text(ren, buf, 10, WIN_H - 52, (SDL_Color) {255, 255, 120, 255});
+		if (save_status[0] && now_seconds() - save_status_time < 4.0) draw_text(ren, save_status, 10, WIN_H - 100, (SDL_Color) {255, 255, 120, 255});
+		if (edit_job.kind != JOB_NONE) {
+			if (edit_job.total) snprintf(buf, sizeof(buf), "Editing... %d%%", (int) (100.0 * edit_job.done / edit_job.total));
+			else
+				snprintf(buf, sizeof(buf), "Flood fill... %zu cells", edit_job.done);
+			draw_text(ren, buf, 10, WIN_H - 76, (SDL_Color) {255, 255, 120, 255});
+		}
+	}
+}
+
+/* ---------------- leaderboard (append-only log + sorted index) ---------------- */
+/* Completion times live in an append-only log of fixed-size records. A snapshot holds
+ * every record up to some log offset, already sorted, so startup reads the snapshot in
+ * one go and only replays the log tail written since. In memory all records sit in one
+ * array sorted by (map, time); a map's entries are a contiguous range found by binary
+ * search, which gives top-N and rank queries in O(log n). */
+#define LB_LOG_FILE "leaderboard.log"
+#define LB_SNAP_FILE "leaderboard.snap"
+#define LB_SNAP_MAGIC 0x31424c4au /* "JLB1" */
+#define LB_COMPACT_EVERY 4096
+
+typedef struct {
+	uint64_t map_hash;
+	uint32_t time_ms;
+	uint32_t when; /* unix seconds */
+} ScoreRec;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t rec_size;
+	uint64_t count;
+	uint64_t log_offset; /* log bytes already folded into this snapshot */
+} ScoreSnapHeader;
+
+static ScoreRec *lb_recs = NULL;
+static size_t lb_count = 0, lb_cap = 0;
+static uint64_t lb_log_size = 0;
+static size_t lb_tail = 0; /* records in the log but not in the snapshot */
+static int lb_capped = 0; /* the index could not grow (scores budget): new times are only logged */
+
+static uint64_t map_hash(void) {
+	/* FNV-1a over dimensions and both grids, so renamed copies of a map share a board */
+	uint64_t h = 1469598103934665603ull;
+	uint32_t dims[2] = {(uint32_t) map_w, (uint32_t) map_h};
+	const uint8_t *d = (const uint8_t *) dims;
+	for (size_t i = 0; i < sizeof(dims); ++i) h = (h ^ d[i]) * 1099511628211ull;
+	size_t n = (size_t) map_w * map_h;
+	for (size_t i = 0; i < n; ++i) h = (h ^ map_cells[i]) * 1099511628211ull;
+	for (size_t i = 0; i < n; ++i) h = (h ^ map_rots[i]) * 1099511628211ull;
+	return h;
+}
+
+static int score_cmp(const void *a, const void *b) {
+	const ScoreRec *x = (const ScoreRec *) a, *y = (const ScoreRec *) b;
+	if (x->map_hash != y->map_hash) return x->map_hash < y->map_hash ? -1 : 1;
+	if (x->time_ms != y->time_ms) return x->time_ms < y->time_ms ? -1 : 1;
+	return x->when < y->when ? -1 : (x->when > y->when);
+}
+
+static int lb_reserve(size_t n) {
+	if (n <= lb_cap) return 0;
+	size_t max_recs = SIZE_MAX / sizeof(ScoreRec);
+	if (mem_budget[MEM_SCORES] && mem_budget[MEM_SCORES] / sizeof(ScoreRec) < max_recs) max_recs = mem_budget[MEM_SCORES] / sizeof(ScoreRec);
+	if (n > max_recs) {
+		lb_capped = 1;
+		return -4;
+	}
+	size_t cap = lb_cap ? lb_cap : 1024;
+	while (cap < n) cap = cap > max_recs / 2 ? max_recs : cap * 2;
+	if (cap > max_recs) cap = max_recs;
+	ScoreRec *r = (ScoreRec *) realloc(lb_recs, cap * sizeof(ScoreRec));
+	if (!r) {
+		lb_capped = 1;
+		return -2;
+	}
+	lb_recs = r;
+	lb_cap = cap;
+	mem_used[MEM_SCORES] = lb_cap * sizeof(ScoreRec);
+	return 0;
+}
+
+/* read up to max records from fd into the end of lb_recs; returns records read */
+static size_t lb_read_records(int fd, size_t max) {
+	if (lb_reserve(lb_count + max) != 0) return 0;
+	size_t want = max * sizeof(ScoreRec), got = 0;
+	char *dst = (char *) (lb_recs + lb_count);
+	while (got < want) {
+		ssize_t n = read(fd, dst + got, want - got);
+		if (n <= 0) break;
+		got += (size_t) n;
+	}
+	size_t recs = got / sizeof(ScoreRec);
+	lb_count += recs;
+	return recs;
+}
+
+/* first index in [lo, hi) not less than (hash, ms) */
+static size_t lb_lower_bound(size_t lo, size_t hi, uint64_t hash, uint32_t ms) {
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		const ScoreRec *r = &lb_recs[mid];
+		if (r->map_hash < hash || (r->map_hash == hash && r->time_ms < ms)) lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
 
-	if (mapfile) {
-		if (load_map_json_like(mapfile) != 0) {
-			fprintf(stderr, "Failed to load %s, generating demo map\n", mapfile);
+/* contiguous range of a map's records in time order */
+static size_t lb_range(uint64_t hash, size_t *count) {
+	size_t first = lb_lower_bound(0, lb_count, hash, 0);
+	size_t lo = first, hi = lb_count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (lb_recs[mid].map_hash == hash) lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*count = lo - first;
+	return first;
+}
+
+static int lb_write_snapshot(void) {
+	if (lb_capped) return -1; /* the index is missing records; the log still has them all */
+	char path[600], tmp[620];
+	data_path(LB_SNAP_FILE, path, sizeof(path));
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return -1;
+	ScoreSnapHeader hdr = {LB_SNAP_MAGIC, (uint32_t) sizeof(ScoreRec), lb_count, lb_log_size};
+	int ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t) sizeof(hdr);
+	size_t bytes = lb_count * sizeof(ScoreRec), done = 0;
+	while (ok && done < bytes) {
+		ssize_t n = write(fd, (const char *) lb_recs + done, bytes - done);
+		if (n <= 0) ok = 0;
+		else
+			done += (size_t) n;
+	}
+	if (ok && fsync(fd) != 0) ok = 0;
+	close(fd);
+	if (!ok || rename(tmp, path) != 0) {
+		unlink(tmp);
+		return -1;
+	}
+	lb_tail = 0;
+	return 0;
+}
+
+static void lb_open(void) {
+	char path[600];
+	uint64_t log_offset = 0;
+	lb_count = 0;
+	lb_capped = 0;
+	int fd = open(data_path(LB_SNAP_FILE, path, sizeof(path)), O_RDONLY);
+	if (fd >= 0) {
+		ScoreSnapHeader hdr;
+		struct stat st;
+		/* the header's count must account for the file exactly, or it is not trusted */
+		if (fstat(fd, &st) == 0 && read(fd, &hdr, sizeof(hdr)) == (ssize_t) sizeof(hdr) && hdr.magic == LB_SNAP_MAGIC && hdr.rec_size == sizeof(ScoreRec) &&
+			(uint64_t) st.st_size >= sizeof(hdr) && hdr.count == ((uint64_t) st.st_size - sizeof(hdr)) / sizeof(ScoreRec) && ((uint64_t) st.st_size - sizeof(hdr)) % sizeof(ScoreRec) == 0) {
+			if (lb_read_records(fd, (size_t) hdr.count) == hdr.count) log_offset = hdr.log_offset;
+			else
+				lb_count = 0; /* torn snapshot: rebuild from the whole log */
+		}
+		close(fd);
+	}
+	lb_log_size = 0;
+	lb_tail = 0;
+	fd = open(data_path(LB_LOG_FILE, path, sizeof(path)), O_RDONLY);
+	if (fd >= 0) {
+		struct stat st;
+		if (fstat(fd, &st) == 0) {
+			/* a partially written trailing record is ignored */
+			lb_log_size = (uint64_t) st.st_size - (uint64_t) st.st_size % sizeof(ScoreRec);
+			if (log_offset > lb_log_size) {
+				log_offset = 0; /* log was replaced; trust it over the snapshot */
+				lb_count = 0;
+			}
+			if (lseek(fd, (off_t) log_offset, SEEK_SET) == (off_t) log_offset) {
+				size_t before = lb_count;
+				lb_read_records(fd, (size_t) ((lb_log_size - log_offset) / sizeof(ScoreRec)));
+				lb_tail = lb_count - before;
+			}
+		}
+		close(fd);
+	}
+	if (lb_tail) qsort(lb_recs, lb_count, sizeof(ScoreRec), score_cmp);
+	if (lb_tail >= LB_COMPACT_EVERY) lb_write_snapshot();
+}
+
+static void lb_close(void) {
+	if (lb_tail) lb_write_snapshot();
+	free(lb_recs);
+	lb_recs = NULL;
+	lb_count = lb_cap = 0;
+	mem_used[MEM_SCORES] = 0;
+}
+
+/* append a completion to the log and the index; returns its 1-based rank for the map,
+ * or 0 when the index is over the scores budget and the time was only logged */
+static int lb_record(uint64_t hash, uint32_t ms) {
+	if (ms == UINT32_MAX) --ms;
+	ScoreRec rec = {hash, ms, (uint32_t) time(NULL)};
+	char path[600];
+	int fd = open(data_path(LB_LOG_FILE, path, sizeof(path)), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd >= 0) {
+		if (write(fd, &rec, sizeof(rec)) == (ssize_t) sizeof(rec)) {
+			lb_log_size += sizeof(rec);
+			++lb_tail;
+		}
+		close(fd);
+	}
+	if (lb_capped || lb_reserve(lb_count + 1) != 0) return 0;
+	size_t at = lb_lower_bound(0, lb_count, hash, ms + 1); /* after equal times */
+	memmove(&lb_recs[at + 1], &lb_recs[at], (lb_count - at) * sizeof(ScoreRec));
+	lb_recs[at] = rec;
+	++lb_count;
+	if (lb_tail >= LB_COMPACT_EVERY) lb_write_snapshot();
+	size_t n, first = lb_range(hash, &n);
+	return (int) (lb_lower_bound(first, first + n, hash, ms) - first) + 1;
+}
+
+static void finish_run(void) {
+	uint64_t hash = map_hash();
+	result_ms = (uint32_t) (run_time * 1000.0 + 0.5);
+	result_rank = lb_record(hash, result_ms);
+	size_t n, first = lb_range(hash, &n);
+	result_total = (int) n;
+	result_nbest = n < 3 ? (int) n : 3;
+	for (int i = 0; i < result_nbest; ++i) result_best[i] = lb_recs[first + i].time_ms;
+	run_recorded = 1;
+}
+
+/* ---------------- batch tool (headless validate / convert / stats) ---------------- */
+/* jumpi --check [--convert <out-dir> json|compact|jmap] [--generate <seed> <size>] <map or directory>...
+ * Runs without a window. Each map goes through load_map_file, and directories are
+ * scanned for .json and .jmap files. Maps are handed to one worker per core through an
+ * atomic counter, and every map is freed before the worker takes the next one. Reports
+ * are printed in input order once all workers finish. Exits 1 if any map is invalid. */
+#define TOOL_MAX_THREADS 64
+
+enum { TOOL_BAD_SIZE = 1,
+	   TOOL_BAD_TYPE = 2,
+	   TOOL_BAD_ROT = 4,
+	   TOOL_NO_END = 8,
+	   TOOL_BAD_SPAWN = 16 };
+
+typedef struct {
+	char path[512];
+	int load_res, convert_res;
+	int w, h;
+	unsigned problems; /* TOOL_* bits */
+	size_t counts[4], unknown, bad_rots, ragged;
+	double ms;
+} MapReport;
+
+static MapReport *tool_reports = NULL;
+static int tool_count = 0, tool_cap = 0;
+static SDL_atomic_t tool_next;
+static const char *tool_out_dir = NULL;
+static int tool_format = 0; /* 0 json, 1 compact json, 2 binary */
+
+static int tool_add(const char *path) {
+	if (tool_count == tool_cap) {
+		int cap = tool_cap ? tool_cap * 2 : 64;
+		MapReport *r = (MapReport *) realloc(tool_reports, (size_t) cap * sizeof(MapReport));
+		if (!r) return -2;
+		tool_reports = r;
+		tool_cap = cap;
+	}
+	MapReport *r = &tool_reports[tool_count++];
+	memset(r, 0, sizeof(*r));
+	snprintf(r->path, sizeof(r->path), "%s", path);
+	return 0;
+}
+
+static int tool_is_map(const char *name) {
+	size_t n = strlen(name);
+	return (n > 5 && strcmp(name + n - 5, ".json") == 0) || (n > 5 && strcmp(name + n - 5, ".jmap") == 0);
+}
+
+static int tool_name_cmp(const void *a, const void *b) { return strcmp(((const MapReport *) a)->path, ((const MapReport *) b)->path); }
+
+/* add a file, or the map files directly inside a directory (sorted) */
+static int tool_collect(const char *path) {
+	struct stat st;
+	if (stat(path, &st) != 0) return -1;
+	if (!S_ISDIR(st.st_mode)) return tool_add(path);
+	DIR *d = opendir(path);
+	if (!d) return -1;
+	int first = tool_count;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+		if (!tool_is_map(e->d_name)) continue;
+		char full[512];
+		snprintf(full, sizeof(full), "%s/%s", path, e->d_name);
+		if (tool_add(full) != 0) break;
+	}
+	closedir(d);
+	if (tool_count > first) qsort(tool_reports + first, (size_t) (tool_count - first), sizeof(MapReport), tool_name_cmp);
+	return 0;
+}
+
+static void tool_check_map(MapReport *r, const Map *m) {
+	size_t n = (size_t) m->w * m->h;
+	r->w = m->w;
+	r->h = m->h;
+	for (size_t i = 0; i < n; ++i) {
+		uint8_t t = m->cells[i];
+		if (t <= TILE_END) r->counts[t]++;
+		else
+			r->unknown++;
+		if (m->rots[i] > 3) r->bad_rots++;
+	}
+	r->bad_rots += m->wrapped_rots;
+	r->ragged = m->ragged_rows;
+	if (r->ragged) r->problems |= TOOL_BAD_SIZE;
+	if (r->unknown) r->problems |= TOOL_BAD_TYPE;
+	if (r->bad_rots) r->problems |= TOOL_BAD_ROT;
+	if (!r->counts[TILE_END]) r->problems |= TOOL_NO_END;
+	/* the player spawns at (3.5, 3.5) standing 2 units up, above any tile (tiles are one
+	 * unit tall), so the spawn is only "inside" something when it is off the grid, where
+	 * tile_at reports solid, or on the end tile, which finishes the level at once */
+	int sx0 = (int) floor(3.5 - PLAYER_RADIUS), sx1 = (int) floor(3.5 + PLAYER_RADIUS);
+	if (m->w <= sx1 || m->h <= sx1) r->problems |= TOOL_BAD_SPAWN;
+	else
+		for (int z = sx0; z <= sx1; ++z)
+			for (int x = sx0; x <= sx1; ++x)
+				if (m->cells[(size_t) z * m->w + x] == TILE_END) r->problems |= TOOL_BAD_SPAWN;
+}
+
+#define TOOL_OUT_PATH 1100
+
+/* <out-dir>/<stem><ext> for an input path */
+static void tool_out_path(const char *path, char *out) {
+	static const char *exts[] = {".json", ".json", ".jmap"};
+	const char *base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+	const char *dot = strrchr(base, '.');
+	int stem = dot ? (int) (dot - base) : (int) strlen(base);
+	snprintf(out, TOOL_OUT_PATH, "%s/%.*s%s", tool_out_dir, stem, base, exts[tool_format]);
+}
+
+static int tool_out_cmp(const void *a, const void *b) { return strcmp((const char *) a, (const char *) b); }
+
+/* inputs that would convert to the same file (a/x.json and b/x.json, or x.json and
+ * x.jmap) are reported before any worker runs; returns the number of clashes */
+static int tool_out_clashes(void) {
+	char *outs = (char *) malloc((size_t) tool_count * TOOL_OUT_PATH);
+	if (!outs) return 0;
+	for (int i = 0; i < tool_count; ++i) tool_out_path(tool_reports[i].path, outs + (size_t) i * TOOL_OUT_PATH);
+	qsort(outs, (size_t) tool_count, TOOL_OUT_PATH, tool_out_cmp);
+	int clashes = 0;
+	for (int i = 1; i < tool_count; ++i) {
+		const char *o = outs + (size_t) i * TOOL_OUT_PATH;
+		if (strcmp(o, o - TOOL_OUT_PATH) != 0) continue;
+		if (i == 1 || strcmp(o, o - 2 * TOOL_OUT_PATH) != 0) {
+			fprintf(stderr, "Several inputs convert to %s:", o);
+			for (int k = 0; k < tool_count; ++k) {
+				char mine[TOOL_OUT_PATH];
+				tool_out_path(tool_reports[k].path, mine);
+				if (strcmp(mine, o) == 0) fprintf(stderr, " %s", tool_reports[k].path);
+			}
+			fprintf(stderr, "\n");
+			clashes++;
+		}
+	}
+	free(outs);
+	return clashes;
+}
+
+static void tool_convert(MapReport *r, const Map *m) {
+	char out[TOOL_OUT_PATH];
+	tool_out_path(r->path, out);
+	r->convert_res = map_save_file(out, m->w, m->h, m->cells, m->rots, tool_format == 0);
+}
+
+static int tool_worker_main(void *data) {
+	(void) data;
+	int i;
+	while ((i = SDL_AtomicAdd(&tool_next, 1)) < tool_count) {
+		MapReport *r = &tool_reports[i];
+		Map m;
+		double t0 = now_seconds();
+		r->load_res = load_map_file(r->path, &m);
+		if (r->load_res == 0) {
+			tool_check_map(r, &m);
+			if (tool_out_dir && !r->problems) tool_convert(r, &m);
+			map_free(&m);
+		}
+		r->ms = (now_seconds() - t0) * 1000.0;
+	}
+	return 0;
+}
+
+static void tool_print(const MapReport *r) {
+	if (r->load_res != 0) {
+		printf("FAIL  %s  cannot load (%s)\n", r->path, r->load_res == -1 ? "cannot open" : r->load_res == -2 ? "out of memory" : r->load_res == -4 ? "over the map or render budget" : "not a map");
+		return;
+	}
+	size_t n = (size_t) r->w * r->h;
+	printf("%s  %s  %dx%d  cubes %zu  wedges %zu  ends %zu  filled %.1f%%  %.2f ms", r->problems ? "FAIL" : "ok  ", r->path, r->w, r->h, r->counts[TILE_CUBE], r->counts[TILE_WEDGE], r->counts[TILE_END], n ? 100.0 * (n - r->counts[TILE_EMPTY]) / n : 0.0, r->ms);
+	if (r->problems & TOOL_BAD_SIZE) printf("; %zu rows do not match %dx%d", r->ragged, r->w, r->h);
+	if (r->problems & TOOL_BAD_TYPE) printf("; %zu cells of unknown type", r->unknown);
+	if (r->problems & TOOL_BAD_ROT) printf("; %zu rotations beyond 0-3", r->bad_rots);
+	if (r->problems & TOOL_NO_END) printf("; no end tile");
+	if (r->problems & TOOL_BAD_SPAWN) printf(r->w < 4 || r->h < 4 ? "; smaller than the 4x4 spawn area" : "; spawn on the end tile");
+	if (tool_out_dir && !r->problems && r->convert_res != 0) printf("; conversion failed (%d)", r->convert_res);
+	printf("\n");
+}
+
+/* generates a course, saves it as compact JSON next to the other data files, loads it
+ * back and compares the grids cell for cell */
+static int tool_roundtrip(uint32_t seed, int size) {
+	Map gen, back;
+	int res = generate_course(seed, size, &gen);
+	if (res != 0) {
+		printf("FAIL  generated %u %d  cannot generate (%d)\n", seed, size, res);
+		return 1;
+	}
+	char path[512];
+	data_path("roundtrip.json", path, sizeof(path));
+	double t0 = now_seconds();
+	res = map_save_file(path, gen.w, gen.h, gen.cells, gen.rots, 0);
+	if (res == 0) res = load_map_file(path, &back);
+	unlink(path);
+	double ms = (now_seconds() - t0) * 1000.0;
+	size_t n = (size_t) gen.w * gen.h;
+	int same = res == 0 && back.w == gen.w && back.h == gen.h && memcmp(back.cells, gen.cells, n) == 0 && memcmp(back.rots, gen.rots, n) == 0;
+	printf("%s  generated %u %dx%d  save/load round trip %s  %.2f ms\n", same ? "ok  " : "FAIL", seed, gen.w, gen.h, res != 0 ? "failed" : same ? "matches" : "differs", ms);
+	if (res == 0) map_free(&back);
+	map_free(&gen);
+	return same ? 0 : 1;
+}
+
+static int tool_main(int argc, char **argv) {
+	static const char usage[] = "usage: jumpi --check [--convert <out-dir> json|compact|jmap] [--generate <seed> <size>] <map or directory>...\n";
+	int roundtrips = 0, roundtrip_bad = 0;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc) {
+			uint32_t seed = parse_seed(argv[i + 1]);
+			roundtrip_bad += tool_roundtrip(seed, atoi(argv[i + 2]));
+			roundtrips++;
+			i += 2;
+		} else if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc) {
+			tool_out_dir = argv[++i];
+			const char *fmt = argv[++i];
+			tool_format = strcmp(fmt, "jmap") == 0 ? 2 : strcmp(fmt, "compact") == 0 ? 1 : strcmp(fmt, "json") == 0 ? 0 : -1;
+			if (tool_format < 0) {
+				fprintf(stderr, "Unknown output format '%s'\n%s", fmt, usage);
+				free(tool_reports);
+				return 2;
+			}
+			mkdir(tool_out_dir, 0755);
+		} else if (tool_collect(argv[i]) != 0)
+			fprintf(stderr, "Cannot read %s\n", argv[i]);
+	}
+	if (!tool_count) {
+		if (roundtrips) return roundtrip_bad ? 1 : 0;
+		fprintf(stderr, "%s", usage);
+		return 2;
+	}
+	if (tool_out_dir && tool_out_clashes()) {
+		fprintf(stderr, "Nothing converted: rename the inputs so every output name is unique\n");
+		free(tool_reports);
+		return 2;
+	}
+	double t0 = now_seconds();
+	int nthreads = SDL_GetCPUCount();
+	if (nthreads > TOOL_MAX_THREADS) nthreads = TOOL_MAX_THREADS;
+	if (nthreads > tool_count) nthreads = tool_count;
+	if (nthreads < 1) nthreads = 1;
+	SDL_Thread *threads[TOOL_MAX_THREADS] = {0};
+	SDL_AtomicSet(&tool_next, 0);
+	for (int t = 1; t < nthreads; ++t) threads[t] = SDL_CreateThread(tool_worker_main, "map-check", NULL);
+	tool_worker_main(NULL);
+	for (int t = 1; t < nthreads; ++t)
+		if (threads[t]) SDL_WaitThread(threads[t], NULL);
+	double secs = now_seconds() - t0;
+
+	int bad = 0;
+	size_t cells = 0, counts[4] = {0};
+	for (int i = 0; i < tool_count; ++i) {
+		const MapReport *r = &tool_reports[i];
+		tool_print(r);
+		if (r->load_res != 0 || r->problems || (tool_out_dir && r->convert_res != 0)) bad++;
+		cells += (size_t) r->w * r->h;
+		for (int k = 0; k < 4; ++k) counts[k] += r->counts[k];
+	}
+	printf("%d maps, %d ok, %d failed; %zu cells (%zu cubes, %zu wedges, %zu ends) in %.1f ms on %d threads\n", tool_count, tool_count - bad, bad, cells, counts[TILE_CUBE], counts[TILE_WEDGE], counts[TILE_END], secs * 1000.0, nthreads);
+	free(tool_reports);
+	return bad || roundtrip_bad ? 1 : 0;
+}
+
+/* ---------------- startup (map and font off the main thread) ---------------- */
+/* SDL video init, the window and the renderer have to happen on the main thread. The
+ * map (load, generation, campaign or endless start, then its chunk cache) and the
+ * leaderboard are prepared on a "startup" thread at the same time, and main joins it
+ * just before the first frame. The font is opened on its own thread once the renderer exists. Until it is picked up
+ * by font_poll, frames draw the text-less HUD, and the glyph cache fills on first use. */
+typedef struct {
+	const char *campaign, *mapfile;
+	int endless, gen_size;
+	uint32_t gen_seed;
+	double ms;
+} StartupJob;
+
+static SDL_Thread *font_thread = NULL;
+static SDL_atomic_t font_done;
+static TTF_Font *font_loaded = NULL; /* owned by font_thread until font_done */
+static int ttf_ready = 0;
+
+static int startup_main(void *data) {
+	StartupJob *job = (StartupJob *) data;
+	double t0 = now_seconds();
+	if (job->campaign) {
+		int res = campaign_start(job->campaign);
+		if (res != 0) {
+			fprintf(stderr, "Failed to start campaign %s (code %d), generating demo map\n", job->campaign, res);
+			generate_demo_map();
+		}
+	} else if (job->endless) {
+		if (stream_start(job->gen_seed) != 0) {
+			fprintf(stderr, "Cannot start the endless course, generating demo map\n");
+			generate_demo_map();
+		}
+	} else if (job->gen_size) {
+		int res = generate_course_map(job->gen_seed, job->gen_size);
+		if (res != 0) {
+			fprintf(stderr, "Cannot generate a %dx%d course (%s), generating demo map\n", job->gen_size, job->gen_size, res == -3 ? "size must be 32 to 16384" : res == -4 ? "over the map or render memory budget" : "out of memory");
+			generate_demo_map();
+		}
+	} else if (job->mapfile) {
+		if (load_map_json_like(job->mapfile) != 0) {
+			fprintf(stderr, "Failed to load %s, generating demo map\n", job->mapfile);
 			generate_demo_map();
 		}
 	} else
 		generate_demo_map();
+	chunk_cache_build();
+	lb_open();
+	job->ms = (now_seconds() - t0) * 1000.0;
+	return 0;
+}
+
+static int font_load_main(void *data) {
+	(void) data;
+	if (TTF_Init() != 0) fprintf(stderr, "TTF_Init failed: %s\n", TTF_GetError()); /* continue without text */
+	else {
+		ttf_ready = 1;
+		/* try common fonts */
+		const char *font_paths[] = {"assets/DejaVuSans.ttf", "/usr/share/fonts/TTF/DejaVuSans.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", NULL};
+		for (int i = 0; font_paths[i]; ++i) {
+			if (access(font_paths[i], R_OK) == 0) {
+				font_loaded = TTF_OpenFont(font_paths[i], 16);
+				if (font_loaded) {
+					fprintf(stderr, "Loaded font: %s\n", font_paths[i]);
+					break;
+				} else
+					fprintf(stderr, "TTF_OpenFont failed for %s: %s\n", font_paths[i], TTF_GetError());
+			}
+		}
+	}
+	if (!font_loaded) fprintf(stderr, "Warning: TTF font not found; text will be limited.\n");
+	SDL_AtomicSet(&font_done, 1);
+	return 0;
+}
+
+/* pick up the font once its thread is done; wait blocks (exit only) */
+static void font_poll(int wait) {
+	if (!font_thread || (!wait && !SDL_AtomicGet(&font_done))) return;
+	SDL_WaitThread(font_thread, NULL);
+	font_thread = NULL;
+	gfont = font_loaded;
+}
+
+/* ---------------- main ---------------- */
+int main(int argc, char **argv) {
+	double start_time = now_seconds();
+	if (argc > 1 && strcmp(argv[1], "--check") == 0) return tool_main(argc, argv);
+	const char *mapfile = NULL;
+	long max_frames = 0; /* --frames N: quit after N frames (scripted runs) */
+	int gen_size = 0; /* --generate <seed> <size>: play a procedural course */
+	int endless = 0; /* --endless <seed>: play the streamed endless course */
+	const char *campaign = NULL; /* --campaign <manifest>: play a list of levels */
+	uint32_t gen_seed = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) max_frames = atol(argv[++i]);
+		else if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc) {
+			gen_seed = parse_seed(argv[++i]);
+			gen_size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--campaign") == 0 && i + 1 < argc) {
+			campaign = argv[++i];
+		} else if (strcmp(argv[i], "--endless") == 0 && i + 1 < argc) {
+			gen_seed = parse_seed(argv[++i]);
+			endless = 1;
+		}
+		else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+			/* --budget <subsystem>=<KiB>, 0 for none */
+			const char *spec = argv[++i], *eq = strchr(spec, '=');
+			int found = 0;
+			for (int k = 0; eq && k < MEM_SYS_COUNT; ++k)
+				if (strlen(mem_sys_names[k]) == (size_t) (eq - spec) && strncmp(spec, mem_sys_names[k], eq - spec) == 0) {
+					mem_budget[k] = (size_t) atol(eq + 1) * 1024;
+					found = 1;
+				}
+			if (!found) fprintf(stderr, "Unknown budget '%s' (use map=, render=, text=, undo= or scores= with KiB)\n", spec);
+		} else
+			mapfile = argv[i];
+	}
+#ifdef JUMPI_TRACK_ALLOCS
+	alloc_main_thread = SDL_ThreadID();
+	SDL_SetMemoryFunctions(track_malloc, track_calloc, track_realloc, track_free);
+#endif
+
+	StartupJob startup = {campaign, mapfile, endless, gen_size, gen_seed, 0.0};
+	SDL_Thread *startup_thread = SDL_CreateThread(startup_main, "startup", &startup);
+	if (!startup_thread) startup_main(&startup);
 
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
 		fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+		SDL_WaitThread(startup_thread, NULL);
 		return 1;
 	}
-	if (TTF_Init() != 0) { fprintf(stderr, "TTF_Init failed: %s\n", TTF_GetError()); /* continue without text */ }
 
 	SDL_Window *win = SDL_CreateWindow("Obby Full Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIN_W, WIN_H, SDL_WINDOW_SHOWN);
 	if (!win) {
 		fprintf(stderr, "CreateWindow failed: %s\n", SDL_GetError());
-		TTF_Quit();
+		SDL_WaitThread(startup_thread, NULL);
 		SDL_Quit();
 		return 1;
 	}
@@ -634,28 +3498,22 @@ int main(int argc, char **argv) {
 	if (!ren) {
 		fprintf(stderr, "CreateRenderer failed: %s\n", SDL_GetError());
 		SDL_DestroyWindow(win);
-		TTF_Quit();
+		SDL_WaitThread(startup_thread, NULL);
 		SDL_Quit();
 		return 1;
 	}
+	double sdl_ms = (now_seconds() - start_time) * 1000.0;
 
-	/* try common fonts */
-	const char *font_paths[] = {"assets/DejaVuSans.ttf", "/usr/share/fonts/TTF/DejaVuSans.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", NULL};
-	gfont = NULL;
-	for (int i = 0; font_paths[i]; ++i) {
-		if (access(font_paths[i], R_OK) == 0) {
-			gfont = TTF_OpenFont(font_paths[i], 16);
-			if (gfont) {
-				fprintf(stderr, "Loaded font: %s\n", font_paths[i]);
-				break;
-			} else
-				fprintf(stderr, "TTF_OpenFont failed for %s: %s\n", font_paths[i], TTF_GetError());
-		}
+	SDL_AtomicSet(&font_done, 0);
+	font_thread = SDL_CreateThread(font_load_main, "font-load", NULL);
+	if (!font_thread) {
+		font_load_main(NULL);
+		gfont = font_loaded;
 	}
-	if (!gfont) fprintf(stderr, "Warning: TTF font not found; text will be limited.\n");
 
 	SDL_SetRelativeMouseMode(SDL_TRUE);
 	SDL_StartTextInput();
+	SDL_WaitThread(startup_thread, NULL); /* the map is needed from here on */
 
 	Player state_prev, state_curr;
 	memset(&state_prev, 0, sizeof(state_prev));
@@ -685,6 +3543,13 @@ int main(int argc, char **argv) {
 	int debug_frame = 0;
 
 	while (running) {
+#ifdef JUMPI_TRACK_ALLOCS
+		memset(alloc_frame, 0, sizeof(alloc_frame));
+		memset(free_frame, 0, sizeof(free_frame));
+		alloc_expected = 0;
+#endif
+		ALLOC_SCOPE(ALLOC_SYS_EVENTS);
+		font_poll(0);
 		double cur = now_seconds();
 		double frame_dt = clampd(cur - prev_time, 0.0, 0.25);
 		prev_time = cur;
@@ -708,6 +3573,7 @@ int main(int argc, char **argv) {
 					SDL_SetRelativeMouseMode(SDL_FALSE);
 				} else if (menu_open && ev.key.keysym.sym == SDLK_ESCAPE) {
 					if (menu_sub != 0) {
+						browser_close();
 						menu_sub = 0;
 						load_path_len = 0;
 						load_path[0] = '\0';
@@ -719,10 +3585,19 @@ int main(int argc, char **argv) {
 						menu_sub = 0;
 						SDL_SetRelativeMouseMode(SDL_TRUE);
 					}
+				} else if (!menu_open && ev.key.keysym.sym == SDLK_TAB) {
+					if (!stream_active) editor_on = !editor_on; /* the streamed window is not editable */
+					if (editor_on) autosave_last = now_seconds();
+				} else if (!menu_open && ev.key.keysym.sym == SDLK_m) {
+					minimap_on = !minimap_on;
+				} else if (!menu_open && editor_on) {
+					editor_key(&cam, ev.key.keysym.sym);
+				} else if (menu_open && menu_sub == 1 && (ev.key.keysym.sym == SDLK_UP || ev.key.keysym.sym == SDLK_DOWN)) {
+					browser_move(ev.key.keysym.sym == SDLK_UP ? -1 : 1);
 				} else if (menu_open && ev.key.keysym.sym == SDLK_UP) {
-					menu_selected = (menu_selected + 4) % 5;
+					menu_selected = (menu_selected + 6) % 7;
 				} else if (menu_open && ev.key.keysym.sym == SDLK_DOWN) {
-					menu_selected = (menu_selected + 1) % 5;
+					menu_selected = (menu_selected + 1) % 7;
 				} else if (menu_open && ev.key.keysym.sym == SDLK_RETURN) {
 					if (menu_sub == 1) {
 						/* handled in text input Enter below */
@@ -733,18 +3608,45 @@ int main(int argc, char **argv) {
 							SDL_SetRelativeMouseMode(SDL_TRUE);
 						} else if (menu_selected == 1) {
 							menu_sub = 1;
+							browser_open_default();
 							load_path_len = 0;
 							load_path[0] = '\0';
 							load_err[0] = '\0';
 							SDL_StartTextInput();
 							SDL_SetRelativeMouseMode(SDL_FALSE);
 						} else if (menu_selected == 2) {
+							/* a fresh seed each time; the seed is printed so a course can be replayed */
+							uint32_t seed = (uint32_t) time(NULL) ^ (uint32_t) SDL_GetPerformanceCounter();
+							Map m;
+							if (generate_course(seed, GEN_MENU_SIZE, &m) == 0) {
+								play_map(&m, "");
+								fprintf(stderr, "Generated course: seed %u, %dx%d\n", seed, GEN_MENU_SIZE, GEN_MENU_SIZE);
+								player_respawn(&state_curr);
+								level_complete = 0;
+								run_time = 0.0;
+								run_recorded = 0;
+								menu_open = 0;
+								SDL_SetRelativeMouseMode(SDL_TRUE);
+							}
+						} else if (menu_selected == 3) {
+							if (stream_start((uint32_t) time(NULL) ^ (uint32_t) SDL_GetPerformanceCounter()) == 0) {
+								campaign_close();
+								editor_on = 0;
+								player_respawn(&state_curr);
+								cam.z = state_curr.pz;
+								level_complete = 0;
+								run_time = 0.0;
+								run_recorded = 0;
+								menu_open = 0;
+								SDL_SetRelativeMouseMode(SDL_TRUE);
+							}
+						} else if (menu_selected == 4) {
 							menu_sub = 2;
 							SDL_SetRelativeMouseMode(SDL_FALSE);
-						} else if (menu_selected == 3) {
+						} else if (menu_selected == 5) {
 							menu_sub = 3;
 							SDL_SetRelativeMouseMode(SDL_FALSE);
-						} else if (menu_selected == 4) {
+						} else if (menu_selected == 6) {
 							running = 0;
 						}
 					}
@@ -766,6 +3668,7 @@ int main(int argc, char **argv) {
 					load_path_len += add;
 				}
 			}
+			if (ev.type == SDL_MOUSEBUTTONDOWN && editor_on && !menu_open) editor_click(&cam, ev.button.button);
 			if (ev.type == SDL_MOUSEMOTION) {
 				if (!menu_open) {
 					in.mouse_dx += ev.motion.xrel;
@@ -780,41 +3683,40 @@ int main(int argc, char **argv) {
 					}
 				} else if (ev.key.keysym.sym == SDLK_RETURN) {
 					load_err[0] = '\0';
-					if (load_path_len > 0) {
-						uint8_t *old_cells = map_cells;
-						uint8_t *old_rots = map_rots;
-						map_cells = NULL;
-						map_rots = NULL;
-						int res = load_map_json_like(load_path);
+					const char *pick = load_path_len > 0 ? load_path : browser_selected();
+					struct stat st;
+					if (load_path_len > 0 && stat(load_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+						/* a typed directory is browsed rather than loaded */
+						browser_open(load_path);
+						load_path_len = 0;
+						load_path[0] = '\0';
+					} else if (pick) {
+						Map m;
+						int res = load_map_file(pick, &m);
 						if (res == 0) {
+							play_map(&m, pick);
 							state_curr.px = 3.5;
 							state_curr.pz = 3.5;
 							state_curr.py = 2.0;
 							state_curr.vx = state_curr.vy = state_curr.vz = 0.0;
 							state_curr.grounded = 0;
 							state_curr.time_since_grounded = 0.0;
+							level_complete = 0;
+							run_time = 0.0;
+							run_recorded = 0;
 							menu_sub = 0;
 							menu_open = 0;
+							browser_close();
 							SDL_StopTextInput();
 							SDL_SetRelativeMouseMode(SDL_TRUE);
-							if (old_cells) free(old_cells);
-							if (old_rots) free(old_rots);
-						} else {
-							if (map_cells) {
-								free(map_cells);
-								map_cells = NULL;
-							}
-							if (map_rots) {
-								free(map_rots);
-								map_rots = NULL;
-							}
-							map_cells = old_cells;
-							map_rots = old_rots;
+						} else if (res == -4)
+							snprintf(load_err, sizeof(load_err), "Map exceeds the map or render memory budget");
+						else
 							snprintf(load_err, sizeof(load_err), "Failed to load (code %d)", res);
-						}
 					} else
 						snprintf(load_err, sizeof(load_err), "Enter a path first");
 				} else if (ev.key.keysym.sym == SDLK_ESCAPE) {
+					browser_close();
 					menu_sub = 0;
 					load_path_len = 0;
 					load_path[0] = '\0';
@@ -849,12 +3751,29 @@ int main(int argc, char **argv) {
 		}
 
 		/* physics stepping */
+		ALLOC_SCOPE(ALLOC_SYS_PHYSICS);
 		state_prev = state_curr;
 		int substeps = 2;
 		while (accumulator >= PHYS_DT) {
 			for (int s = 0; s < substeps; ++s) physics_step(&state_curr, &in, PHYS_DT / substeps, &level_complete);
+			if (!level_complete) run_time += PHYS_DT;
 			accumulator -= PHYS_DT;
 		}
+		if (level_complete && !run_recorded) finish_run();
+		if (level_complete && campaign_advance()) {
+			/* next level is already in memory: carry straight on */
+			player_respawn(&state_curr);
+			state_prev = state_curr;
+			level_complete = 0;
+			run_time = 0.0;
+			run_recorded = 0;
+		}
+		int shift = stream_advance(state_curr.pz);
+		if (shift) {
+			state_curr.pz -= shift;
+			state_prev.pz -= shift;
+			cam.z -= shift;
+		}
 		double alpha = accumulator / PHYS_DT;
 		Player render_player;
 		render_player.px = state_prev.px + (state_curr.px - state_prev.px) * alpha;
@@ -875,17 +3794,25 @@ int main(int argc, char **argv) {
 		cam.pitch = lerp(cam.pitch, render_player.pitch, 0.18);
 
 		/* render */
+		ALLOC_SCOPE(ALLOC_SYS_WORLD);
 		SDL_SetRenderDrawColor(ren, 12, 12, 20, 255);
 		SDL_RenderClear(ren);
 
 		draw_map(ren, &cam);
 
+		edit_job_step(now_seconds() + EDIT_JOB_SLICE);
+		browser_poll(0);
+		editor_save_tick(now_seconds());
+		if (editor_on) draw_editor(ren, &cam);
+		if (minimap_on) draw_minimap(ren, render_player.px, render_player.pz, render_player.yaw);
+
 		/* crosshair */
 		SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
 		SDL_RenderDrawLine(ren, WIN_W / 2 - 8, WIN_H / 2, WIN_W / 2 + 8, WIN_H / 2);
 		SDL_RenderDrawLine(ren, WIN_W / 2, WIN_H / 2 - 8, WIN_W / 2, WIN_H / 2 + 8);
 
 		/* HUD */
+		ALLOC_SCOPE(ALLOC_SYS_UI);
 		if (gfont) {
 			char hud[256];
 			snprintf(hud, sizeof(hud), "Pos: %.2f %.2f %.2f  Vel: %.2f %.2f %.2f", render_player.px, render_player.py, render_player.pz, render_player.vx, render_player.vy, render_player.vz);
@@ -893,6 +3820,10 @@ int main(int argc, char **argv) {
 			char s2[128];
 			snprintf(s2, sizeof(s2), "Sens: %.4f  InvY:%s InvX:%s", mouse_sensitivity, invert_mouse_y ? "On" : "Off", invert_mouse_x ? "On" : "Off");
 			draw_text(ren, s2, 10, 30, (SDL_Color) {0, 180, 0, 255});
+			if (stream_active) {
+				snprintf(s2, sizeof(s2), "Endless: %ld m", stream_base * GEN_ROOM + (long) render_player.pz);
+				draw_text(ren, s2, 10, 50, (SDL_Color) {0, 180, 0, 255});
+			}
 		} else {
 			/* fallback small HUD blocks */
 			SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
@@ -906,6 +3837,15 @@ int main(int argc, char **argv) {
 			}
 		}
 
+		if (campaign_cur >= 0 && now_seconds() < campaign_banner_until && gfont) {
+			char banner[128];
+			int len = snprintf(banner, sizeof(banner), "Level %d of %d", campaign_cur + 1, campaign_count);
+			if (campaign_cur > 0 && result_rank) snprintf(banner + len, sizeof(banner) - len, "  (last level %.3fs, rank %d)", result_ms / 1000.0, result_rank);
+			else if (campaign_cur > 0 && result_ms)
+				snprintf(banner + len, sizeof(banner) - len, "  (last level %.3fs)", result_ms / 1000.0);
+			draw_text(ren, banner, WIN_W / 2 - 160, 60, (SDL_Color) {180, 255, 180, 255});
+		}
+
 		if (menu_open) {
 			draw_main_menu(ren);
 			if (menu_sub == 1) draw_load_overlay(ren);
@@ -921,11 +3861,28 @@ int main(int argc, char **argv) {
 			SDL_Rect full = {0, 0, WIN_W, WIN_H};
 			SDL_RenderFillRect(ren, &full);
 			SDL_SetRenderDrawColor(ren, 0, 200, 0, 255);
-			SDL_Rect box = {WIN_W / 2 - 200, WIN_H / 2 - 40, 400, 80};
+			SDL_Rect box = {WIN_W / 2 - 200, WIN_H / 2 - 40, 400, 120};
 			SDL_RenderDrawRect(ren, &box);
-			if (gfont) draw_text(ren, "Level Complete! Press R to restart.", WIN_W / 2 - 160, WIN_H / 2 - 8, (SDL_Color) {0, 200, 0, 255});
+			if (gfont) {
+				const char *title = "Level Complete! Press R to restart.";
+				if (campaign_cur >= 0 && campaign_next_index >= 0) title = "Level Complete! Loading next level...";
+				else if (campaign_cur >= 0)
+					title = "Campaign Complete! Press R to replay.";
+				draw_text(ren, title, WIN_W / 2 - 160, WIN_H / 2 - 28, (SDL_Color) {0, 200, 0, 255});
+				char line[128];
+				if (result_rank) snprintf(line, sizeof(line), "Time: %.3fs  Rank %d of %d", result_ms / 1000.0, result_rank, result_total);
+				else
+					snprintf(line, sizeof(line), "Time: %.3fs  (not ranked: scores budget full)", result_ms / 1000.0);
+				draw_text(ren, line, WIN_W / 2 - 160, WIN_H / 2 + 4, (SDL_Color) {0, 200, 0, 255});
+				int len = snprintf(line, sizeof(line), "Best:");
+				for (int i = 0; i < result_nbest; ++i) len += snprintf(line + len, sizeof(line) - len, " %d) %.3fs", i + 1, result_best[i] / 1000.0);
+				draw_text(ren, line, WIN_W / 2 - 160, WIN_H / 2 + 36, (SDL_Color) {0, 180, 0, 255});
+			}
 			if (kb[SDL_SCANCODE_R]) {
+				if (campaign_cur >= 0 && campaign_next_index < 0) campaign_restart(); /* on failure, replay the last level */
 				level_complete = 0;
+				run_time = 0.0;
+				run_recorded = 0;
 				state_curr.px = 3.5;
 				state_curr.pz = 3.5;
 				state_curr.py = 2.0;
@@ -934,9 +3891,29 @@ int main(int argc, char **argv) {
 			}
 		}
 
+		ALLOC_SCOPE(ALLOC_SYS_PRESENT);
 		SDL_RenderPresent(ren);
+		ALLOC_SCOPE(ALLOC_SYS_OTHER);
+		if (debug_frame == 0) fprintf(stderr, "Time to first frame: %.1f ms (SDL and window %.1f ms; map and scores %.1f ms alongside)\n", (now_seconds() - start_time) * 1000.0, sdl_ms, startup.ms);
+
+#ifdef JUMPI_TRACK_ALLOCS
+		/* steady state: gameplay frames after warm-up; menus (map loads, typed text), the
+		 * completion frame (leaderboard insert) and frames marked with ALLOC_EXPECTED
+		 * (campaign level switch, starting or reaping a save) are expected to allocate */
+		long frame_allocs = 0;
+		for (int i = 0; i < ALLOC_SYS_COUNT; ++i) frame_allocs += alloc_frame[i];
+		if (debug_frame >= 120 && !menu_open && !level_complete && !alloc_expected && frame_allocs) {
+			if (steady_alloc_frames++ < 16) {
+				fprintf(stderr, "ALLOC: frame %d:", debug_frame);
+				for (int i = 0; i < ALLOC_SYS_COUNT; ++i)
+					if (alloc_frame[i] || free_frame[i]) fprintf(stderr, " %s=%ld/%ld", alloc_sys_names[i], alloc_frame[i], free_frame[i]);
+				fprintf(stderr, "\n");
+			}
+		}
+#endif
 
 		/* debug print occasionally */
+		if (max_frames && debug_frame + 1 >= max_frames) running = 0;
 		if (++debug_frame % 240 == 0) {
 			double fy = state_curr.yaw;
 			double fx = sin(fy), fz = cos(fy);
@@ -948,13 +3925,31 @@ int main(int argc, char **argv) {
 		SDL_Delay(1);
 	}
 
-	if (map_cells) free(map_cells);
-	if (map_rots) free(map_rots);
+	lb_close();
+	stream_stop();
+	campaign_close();
+	browser_close();
+	browser_poll(1);
+	if (edit_job.kind != JOB_NONE) edit_job_finish();
+	int save_result;
+	char save_path[sizeof(map_path)];
+	if (map_save_poll(1, &save_result, save_path, sizeof(save_path)) && save_result != 0) fprintf(stderr, "Saving %s failed\n", save_path);
+	map_free(&clipboard);
+	journal_clear();
+	chunk_cache_free();
+	map_free(&cur_map);
+	text_cache_free();
+	minimap_free();
+	font_poll(1);
 	if (gfont) TTF_CloseFont(gfont);
-	TTF_Quit();
+	if (ttf_ready) TTF_Quit();
 	SDL_StopTextInput();
 	SDL_DestroyRenderer(ren);
 	SDL_DestroyWindow(win);
 	SDL_Quit();
+#ifdef JUMPI_TRACK_ALLOCS
+	fprintf(stderr, "ALLOC: %d allocations, %d frees, %ld steady-state frames allocated\n", SDL_AtomicGet(&alloc_total), SDL_AtomicGet(&free_total), steady_alloc_frames);
+	if (steady_alloc_frames) return 3;
+#endif
 	return 0;
 }